@@ -0,0 +1,116 @@
+import argparse
+import os
+import random
+import subprocess
+import sys
+import tempfile
+import time
+
+BLOCK_SIZE = 1 << 20
+NUM_BLOCKS = 16
+WORDS = ["int", "return", "x", "wc209", "counter", "the", "a", "while",
+	"state", "buf", "0x7f", "\xe9t\xe9", "if(c)", "i++;", "a/b", "*p"]
+SPACES = ["\t", "\v", "\f", "\r"]
+
+def generate_block(rng, args):
+	# one self-contained block: every comment opened in it is closed in it
+	out = []
+	size = 0
+	while size < BLOCK_SIZE:
+		line = []
+		length = 0
+		target = max(1, int(rng.expovariate(1.0 / args.line_length)))
+		while length < target:
+			if rng.random() < args.space_mix:
+				sep = rng.choice(SPACES) * rng.randint(1, 3)
+			else:
+				sep = " " * rng.randint(1, 2)
+			word = rng.choice(WORDS)
+			line.append(word + sep)
+			length += len(word) + len(sep)
+		if rng.random() < args.comment_density:
+			body = " ".join(rng.choice(WORDS) for i in range(rng.randint(1, 8)))
+			if rng.random() < 0.2:
+				body += "\n * " + body + "\n"
+			line.insert(rng.randint(0, len(line)), "/* " + body + " */")
+		line.append("\n")
+		text = "".join(line)
+		out.append(text)
+		size += len(text)
+	return "".join(out).encode("latin-1")
+
+def generate_corpus(path, args):
+	# deterministic for a given seed: a sequence of NUM_BLOCKS distinct blocks
+	rng = random.Random(args.seed)
+	blocks = [generate_block(rng, args) for i in range(NUM_BLOCKS)]
+	written = 0
+	f = open(path, "wb")
+	while written < args.size * BLOCK_SIZE:
+		block = rng.choice(blocks)
+		f.write(block)
+		written += len(block)
+	f.close()
+	return written
+
+def run(argv, path):
+	f = open(path, "rb")
+	start = time.time()
+	p = subprocess.Popen(argv, stdin=f, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+	out, err = p.communicate()
+	elapsed = time.time() - start
+	f.close()
+	return out.decode("latin-1").strip(), err.decode("latin-1").strip(), elapsed
+
+def best_of(argv, path, repeat):
+	best = None
+	for i in range(repeat):
+		out, err, elapsed = run(argv, path)
+		if best is None or elapsed < best[2]:
+			best = (out, err, elapsed)
+	return best
+
+if __name__ == "__main__":
+
+	parser = argparse.ArgumentParser(description="wc209 throughput benchmark")
+	parser.add_argument("--size", type=int, default=256, help="corpus size in MB")
+	parser.add_argument("--seed", type=int, default=209)
+	parser.add_argument("--comment-density", type=float, default=0.05,
+		help="fraction of lines holding a comment")
+	parser.add_argument("--line-length", type=int, default=60,
+		help="mean line length in bytes")
+	parser.add_argument("--space-mix", type=float, default=0.1,
+		help="fraction of separators that are tabs, \\v, \\f or \\r")
+	parser.add_argument("--modes", default="-g,-r,-m,-r -s,-j 4",
+		help="comma separated wc209 options to time")
+	parser.add_argument("--repeat", type=int, default=3, help="runs per mode, best is kept")
+	parser.add_argument("--corpus", help="keep the corpus at this path")
+	parser.add_argument("--wc209", default="./wc209")
+	parser.add_argument("--sample", default="./samplewc209")
+	args = parser.parse_args()
+
+	path = args.corpus
+	if not path:
+		fd, path = tempfile.mkstemp(prefix="wc209_bench_")
+		os.close(fd)
+
+	nbytes = generate_corpus(path, args)
+	mb = nbytes / float(BLOCK_SIZE)
+	print("[*] corpus: %.1f MB, seed %d, comments %.2f, line %d, space mix %.2f"
+		% (mb, args.seed, args.comment_density, args.line_length, args.space_mix))
+
+	ref_out, ref_err, elapsed = best_of([args.sample], path, 1)
+	print("[*] %-12s %10.1f MB/s  %s" % ("samplewc209", mb / elapsed, ref_out or ref_err))
+
+	failed = 0
+	for mode in args.modes.split(","):
+		out, err, elapsed = best_of([args.wc209] + mode.split(), path, args.repeat)
+		if out != ref_out or err != ref_err:
+			print("[-] %-12s %10.1f MB/s  MISMATCH: %s" % (mode, mb / elapsed, out or err))
+			failed += 1
+		else:
+			print("[+] %-12s %10.1f MB/s" % (mode, mb / elapsed))
+
+	if not args.corpus:
+		os.unlink(path)
+
+	sys.exit(1 if failed else 0)
@@ -0,0 +1,589 @@
+/*--------------------------------------------------------------------*/
+/* counter.c                                                          */
+/*--------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <limits.h>
+#include <pthread.h>
+#include "counter.h"
+
+/* the bit mask path only pays off when it is compiled with
+   optimization; unoptimized, the scalar DFA is faster */
+#if defined(__SSE2__) && defined(__OPTIMIZE__)
+#include <immintrin.h>
+#define HAVE_SIMD 1
+#endif
+
+#define FALSE 0
+#define TRUE  1
+
+/* Counter_feedParallel(): how often speculative lanes are compared */
+#define SPEC_BLOCK (1 << 12)
+/* Counter_feedParallel(): no thread gets less input than this */
+#define MIN_CHUNK (1 << 20)
+
+/* comment_newlines of a lane that has not opened a comment */
+#define NO_COMMENT ULONG_MAX
+
+/* first line of a state saved by Counter_save() */
+#define SAVE_MAGIC "wc209-counter 1"
+
+/* states of the counter DFA (see the file "dfa") */
+enum {
+	ST_OUT,			/* between words */
+	ST_WORD,		/* inside a word */
+	ST_OUT_SLASH,		/* '/' read between words */
+	ST_WORD_SLASH,		/* '/' read inside a word */
+	ST_COMMENT,		/* inside a comment */
+	ST_COMMENT_STAR,	/* '*' read inside a comment */
+	NUM_STATES
+};
+
+/* byte classes the DFA distinguishes */
+enum {
+	CL_OTHER,
+	CL_SPACE,		/* isspace() except '\n' */
+	CL_NEWLINE,
+	CL_SLASH,
+	CL_STAR,
+	NUM_CLASSES
+};
+
+/* one DFA edge: the next state and what taking the edge adds to each
+   counter. opens is 1 on the edge that enters a comment */
+struct transition {
+	unsigned char next;
+	unsigned char chars;
+	unsigned char words;
+	unsigned char lines;
+	unsigned char opens;
+};
+
+/* (state, byte class) -> (next state, counter deltas).
+   a '/' is only counted once the following byte shows it does not
+   start a comment, and a whole comment counts as a single space */
+static const struct transition dfa_table[NUM_STATES][NUM_CLASSES] = {
+	/* ST_OUT */
+	{{ST_WORD, 1, 1, 0, 0}, {ST_OUT, 1, 0, 0, 0}, {ST_OUT, 1, 0, 1, 0},
+	 {ST_OUT_SLASH, 0, 0, 0, 0}, {ST_WORD, 1, 1, 0, 0}},
+	/* ST_WORD */
+	{{ST_WORD, 1, 0, 0, 0}, {ST_OUT, 1, 0, 0, 0}, {ST_OUT, 1, 0, 1, 0},
+	 {ST_WORD_SLASH, 0, 0, 0, 0}, {ST_WORD, 1, 0, 0, 0}},
+	/* ST_OUT_SLASH */
+	{{ST_WORD, 2, 1, 0, 0}, {ST_OUT, 2, 1, 0, 0}, {ST_OUT, 2, 1, 1, 0},
+	 {ST_WORD_SLASH, 1, 1, 0, 0}, {ST_COMMENT, 0, 0, 0, 1}},
+	/* ST_WORD_SLASH */
+	{{ST_WORD, 2, 0, 0, 0}, {ST_OUT, 2, 0, 0, 0}, {ST_OUT, 2, 0, 1, 0},
+	 {ST_WORD_SLASH, 1, 0, 0, 0}, {ST_COMMENT, 0, 0, 0, 1}},
+	/* ST_COMMENT */
+	{{ST_COMMENT, 0, 0, 0, 0}, {ST_COMMENT, 0, 0, 0, 0}, {ST_COMMENT, 1, 0, 1, 0},
+	 {ST_COMMENT, 0, 0, 0, 0}, {ST_COMMENT_STAR, 0, 0, 0, 0}},
+	/* ST_COMMENT_STAR */
+	{{ST_COMMENT, 0, 0, 0, 0}, {ST_COMMENT, 0, 0, 0, 0}, {ST_COMMENT, 1, 0, 1, 0},
+	 {ST_OUT, 1, 0, 0, 0}, {ST_COMMENT_STAR, 0, 0, 0, 0}}
+};
+
+/* byte -> byte class in the C locale, every byte not listed is CL_OTHER */
+static const unsigned char c_byte_class[256] = {
+	['\t'] = CL_SPACE,
+	['\n'] = CL_NEWLINE,
+	['\v'] = CL_SPACE,
+	['\f'] = CL_SPACE,
+	['\r'] = CL_SPACE,
+	[' '] = CL_SPACE,
+	['*'] = CL_STAR,
+	['/'] = CL_SLASH
+};
+
+/* byte -> byte class under the current locale, see COUNTER_LOCALE */
+static unsigned char locale_byte_class[256];
+
+/* the byte class table the DFA runs on */
+static const unsigned char *byte_class = c_byte_class;
+
+/* everything the DFA carries from one block to the next */
+struct Counter {
+	int state;
+
+	unsigned long numbytes;
+	unsigned long numchars;
+	unsigned long numwords;
+	unsigned long numnewlines;	/* '\n' seen so far, comments included */
+	unsigned long comment_newlines;	/* numnewlines when the last comment opened */
+};
+
+/* classifies every byte with isspace() under the current locale */
+static void
+init_locale_classes (void){
+	int c;
+
+	for (c = 0; c < 256; c++) {
+		if (c == '\n') {
+			locale_byte_class[c] = CL_NEWLINE;
+		}
+		else if (isspace(c)) {
+			locale_byte_class[c] = CL_SPACE;
+		}
+		else if (c == '/') {
+			locale_byte_class[c] = CL_SLASH;
+		}
+		else if (c == '*') {
+			locale_byte_class[c] = CL_STAR;
+		}
+		else {
+			locale_byte_class[c] = CL_OTHER;
+		}
+	}
+}
+
+/* runs the DFA byte by byte over len bytes of buf */
+static void
+count_scalar (struct Counter *cnt, const unsigned char *buf, size_t len){
+	unsigned long chars = cnt->numchars;
+	unsigned long words = cnt->numwords;
+	unsigned long newlines = cnt->numnewlines;
+	unsigned long comment_newlines = cnt->comment_newlines;
+	int state = cnt->state;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		const struct transition *t = &dfa_table[state][byte_class[buf[i]]];
+
+		/* only the edge into a comment records its line */
+		comment_newlines ^= (comment_newlines ^ newlines) & -(unsigned long)t->opens;
+		chars += t->chars;
+		words += t->words;
+		newlines += t->lines;
+		state = t->next;
+	}
+
+	cnt->state = state;
+	cnt->numchars = chars;
+	cnt->numwords = words;
+	cnt->numnewlines = newlines;
+	cnt->comment_newlines = comment_newlines;
+}
+
+#ifdef HAVE_SIMD
+/* one bit per byte of a 64-byte chunk */
+struct chunk_masks {
+	uint64_t space;		/* isspace() in the C locale, '\n' included */
+	uint64_t newline;
+	uint64_t slash;
+	uint64_t star;
+};
+
+/* sets the bits of the bytes equal to one of ' ', '\t', '\n', '\v',
+   '\f' and '\r' */
+static __m128i
+sse2_isspace (__m128i v){
+	__m128i ctl = _mm_sub_epi8(v, _mm_set1_epi8('\t'));
+
+	/* '\t'..'\r' are contiguous: an unsigned ctl <= 4 */
+	ctl = _mm_cmpeq_epi8(_mm_min_epu8(ctl, _mm_set1_epi8(4)), ctl);
+	return _mm_or_si128(ctl, _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+}
+
+static void
+classify_sse2 (const unsigned char *p, struct chunk_masks *m){
+	int i;
+
+	memset(m, 0, sizeof(*m));
+	for (i = 0; i < 64; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+
+		m->space |= (uint64_t)(unsigned)_mm_movemask_epi8(sse2_isspace(v)) << i;
+		m->newline |= (uint64_t)(unsigned)_mm_movemask_epi8(
+			_mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))) << i;
+		m->slash |= (uint64_t)(unsigned)_mm_movemask_epi8(
+			_mm_cmpeq_epi8(v, _mm_set1_epi8('/'))) << i;
+		m->star |= (uint64_t)(unsigned)_mm_movemask_epi8(
+			_mm_cmpeq_epi8(v, _mm_set1_epi8('*'))) << i;
+	}
+}
+
+/* same as sse2_isspace() on 32 bytes */
+__attribute__((target("avx2")))
+static __m256i
+avx2_isspace (__m256i v){
+	__m256i ctl = _mm256_sub_epi8(v, _mm256_set1_epi8('\t'));
+
+	ctl = _mm256_cmpeq_epi8(_mm256_min_epu8(ctl, _mm256_set1_epi8(4)), ctl);
+	return _mm256_or_si256(ctl, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+}
+
+__attribute__((target("avx2")))
+static void
+classify_avx2 (const unsigned char *p, struct chunk_masks *m){
+	int i;
+
+	memset(m, 0, sizeof(*m));
+	for (i = 0; i < 64; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+
+		m->space |= (uint64_t)(unsigned)_mm256_movemask_epi8(avx2_isspace(v)) << i;
+		m->newline |= (uint64_t)(unsigned)_mm256_movemask_epi8(
+			_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'))) << i;
+		m->slash |= (uint64_t)(unsigned)_mm256_movemask_epi8(
+			_mm256_cmpeq_epi8(v, _mm256_set1_epi8('/'))) << i;
+		m->star |= (uint64_t)(unsigned)_mm256_movemask_epi8(
+			_mm256_cmpeq_epi8(v, _mm256_set1_epi8('*'))) << i;
+	}
+}
+
+/* chunk classifier for this CPU, NULL when the fast path is off */
+static void (*classify_chunk)(const unsigned char *, struct chunk_masks *);
+
+/* turns the fast path on if byte_class agrees with the classifiers */
+static void
+init_simd (void){
+	int c;
+
+	for (c = 0; c < 256; c++) {
+		int space = (c == ' ' || (c >= '\t' && c <= '\r'));
+
+		if (space != (byte_class[c] == CL_SPACE || byte_class[c] == CL_NEWLINE)) {
+			return;
+		}
+	}
+
+	__builtin_cpu_init();
+	classify_chunk = __builtin_cpu_supports("avx2") ? classify_avx2 : classify_sse2;
+}
+
+/* consumes the first n (1..64) bytes of a chunk in ST_OUT or ST_WORD
+   that holds no '/' among them */
+static void
+bulk_text (struct Counter *cnt, const struct chunk_masks *m, int n){
+	uint64_t valid = (n == 64) ? ~(uint64_t)0 : ((uint64_t)1 << n) - 1;
+	uint64_t word = ~m->space & valid;
+	uint64_t starts = word & ~((word << 1) | (cnt->state == ST_WORD));
+
+	cnt->numchars += n;
+	cnt->numwords += __builtin_popcountll(starts);
+	cnt->numnewlines += __builtin_popcountll(m->newline & valid);
+	cnt->state = ((word >> (n - 1)) & 1) ? ST_WORD : ST_OUT;
+}
+
+/* consumes the first n (1..64) bytes of a chunk in ST_COMMENT that
+   holds no '*' among them */
+static void
+bulk_comment (struct Counter *cnt, const struct chunk_masks *m, int n){
+	uint64_t valid = (n == 64) ? ~(uint64_t)0 : ((uint64_t)1 << n) - 1;
+	int nl = __builtin_popcountll(m->newline & valid);
+
+	cnt->numchars += nl;
+	cnt->numnewlines += nl;
+}
+#endif /* HAVE_SIMD */
+
+/* runs the DFA over len bytes of buf. whole 64-byte chunks of plain
+   text or comment body are counted with bit masks, and only the bytes
+   around a '/' (or a '*' in a comment) go through count_scalar() */
+static void
+count_buffer (struct Counter *cnt, const unsigned char *buf, size_t len){
+	size_t i = 0;
+
+	cnt->numbytes += len;
+
+#ifdef HAVE_SIMD
+	while (classify_chunk && len - i >= 64) {
+		struct chunk_masks m;
+		uint64_t stop;
+		int n;
+
+		if (cnt->state != ST_OUT && cnt->state != ST_WORD &&
+		    cnt->state != ST_COMMENT) {
+			count_scalar(cnt, buf + i, 1);
+			i++;
+			continue;
+		}
+
+		classify_chunk(buf + i, &m);
+		stop = (cnt->state == ST_COMMENT) ? m.star : m.slash;
+		n = stop ? __builtin_ctzll(stop) : 64;
+
+		if (n > 0) {
+			if (cnt->state == ST_COMMENT) {
+				bulk_comment(cnt, &m, n);
+			}
+			else {
+				bulk_text(cnt, &m, n);
+			}
+			i += n;
+		}
+
+		/* the stop byte itself changes state */
+		if (n < 64) {
+			count_scalar(cnt, buf + i, 1);
+			i++;
+		}
+	}
+#endif
+
+	count_scalar(cnt, buf + i, len - i);
+}
+
+/* flushes a pending '/' at the end of the input. returns FALSE on an
+   unterminated comment (see print_comment_error()), TRUE otherwise */
+static int
+count_finish (struct Counter *cnt){
+	switch (cnt->state) {
+		case ST_OUT_SLASH:
+			cnt->numchars++;
+			cnt->numwords++;
+		break;
+
+		case ST_WORD_SLASH:
+			cnt->numchars++;
+		break;
+
+		case ST_COMMENT:
+		case ST_COMMENT_STAR:
+			return FALSE;
+	}
+	cnt->state = ST_OUT;
+	return TRUE;
+}
+
+/* number of lines: a non-empty input has one more line than newlines */
+static unsigned long
+count_lines (const struct Counter *cnt){
+	return cnt->numnewlines + (cnt->numbytes != 0);
+}
+
+/* TRUE if two lanes will count the rest of a chunk identically:
+   same state, and inside a comment, the same opening line */
+static int
+same_lane (const struct Counter *a, const struct Counter *b){
+	return a->state == b->state &&
+		(a->state < ST_COMMENT || a->comment_newlines == b->comment_newlines);
+}
+
+/* counts buf once for every possible start state, res[s] being the
+   lane started in state s. lanes are compared every SPEC_BLOCK bytes
+   and a lane that caught up with a lower one stops and only keeps its
+   difference, so most chunks cost about two passes, not six */
+static void
+count_speculative (const unsigned char *buf, size_t len, struct Counter res[NUM_STATES]){
+	int alias[NUM_STATES];
+	size_t off, n;
+	int s, t;
+
+	for (s = 0; s < NUM_STATES; s++) {
+		memset(&res[s], 0, sizeof(res[s]));
+		res[s].state = s;
+		res[s].comment_newlines = NO_COMMENT;
+		alias[s] = s;
+	}
+
+	for (off = 0; off < len; off += n) {
+		n = (len - off < SPEC_BLOCK) ? len - off : SPEC_BLOCK;
+
+		for (s = 0; s < NUM_STATES; s++) {
+			if (alias[s] == s) {
+				count_buffer(&res[s], buf + off, n);
+			}
+		}
+
+		for (s = 1; s < NUM_STATES; s++) {
+			if (alias[s] != s) {
+				continue;
+			}
+			for (t = 0; t < s; t++) {
+				if (alias[t] == t && same_lane(&res[t], &res[s])) {
+					/* from here on s follows t, keep the offsets
+					   (modulo ULONG_MAX + 1, they may be negative) */
+					alias[s] = t;
+					res[s].numchars -= res[t].numchars;
+					res[s].numwords -= res[t].numwords;
+					break;
+				}
+			}
+		}
+	}
+
+	/* alias[s] < s, so res[alias[s]] is final by the time s is reached */
+	for (s = 1; s < NUM_STATES; s++) {
+		if (alias[s] != s) {
+			t = alias[s];
+			res[s].state = res[t].state;
+			res[s].numchars += res[t].numchars;
+			res[s].numwords += res[t].numwords;
+			res[s].numnewlines = res[t].numnewlines;
+			res[s].comment_newlines = res[t].comment_newlines;
+		}
+	}
+}
+
+/* one Counter_feedParallel() chunk and its per start state results */
+struct chunk {
+	pthread_t thread;
+	const unsigned char *buf;
+	size_t len;
+	struct Counter res[NUM_STATES];
+};
+
+static void *
+chunk_thread (void *arg){
+	struct chunk *ch = arg;
+
+	count_speculative(ch->buf, ch->len, ch->res);
+	return NULL;
+}
+
+/* Counter_configure() has run */
+static int configured = FALSE;
+
+void
+Counter_configure (int iFlags){
+	if (iFlags & COUNTER_LOCALE) {
+		init_locale_classes();
+		byte_class = locale_byte_class;
+	}
+	else {
+		byte_class = c_byte_class;
+	}
+#ifdef HAVE_SIMD
+	classify_chunk = NULL;
+	if (!(iFlags & COUNTER_NO_SIMD)) {
+		init_simd();
+	}
+#endif
+	configured = TRUE;
+}
+
+Counter_T
+Counter_new (void){
+	Counter_T oCounter;
+
+	if (!configured) {
+		Counter_configure(0);
+	}
+
+	if (!(oCounter = calloc(1, sizeof(*oCounter)))) {
+		return NULL;
+	}
+	oCounter->state = ST_OUT;
+	return oCounter;
+}
+
+void
+Counter_free (Counter_T oCounter){
+	free(oCounter);
+}
+
+void
+Counter_feed (Counter_T oCounter, const void *pvBuf, size_t len){
+	count_buffer(oCounter, pvBuf, len);
+}
+
+/* every chunk but the first is counted from all start states at once,
+   then the results are stitched together in order */
+int
+Counter_feedParallel (Counter_T oCounter, const void *pvBuf, size_t len,
+		      int iThreads){
+	const unsigned char *buf = pvBuf;
+	struct chunk *chunks;
+	size_t off;
+	int i;
+
+	if ((size_t)iThreads > len / MIN_CHUNK) {
+		iThreads = (int)(len / MIN_CHUNK);
+	}
+	if (iThreads <= 1) {
+		count_buffer(oCounter, buf, len);
+		return TRUE;
+	}
+
+	if (!(chunks = calloc((size_t)iThreads, sizeof(*chunks)))) {
+		return FALSE;
+	}
+
+	for (i = 0, off = 0; i < iThreads; i++) {
+		chunks[i].buf = buf + off;
+		chunks[i].len = (i == iThreads - 1) ? len - off : len / iThreads;
+		off += chunks[i].len;
+
+		/* the first chunk runs in this thread, its start state is known */
+		if (i > 0 && pthread_create(&chunks[i].thread, NULL, chunk_thread, &chunks[i])) {
+			while (--i > 0) {
+				pthread_join(chunks[i].thread, NULL);
+			}
+			free(chunks);
+			return FALSE;
+		}
+	}
+	count_buffer(oCounter, chunks[0].buf, chunks[0].len);
+
+	for (i = 1; i < iThreads; i++) {
+		const struct Counter *r;
+
+		pthread_join(chunks[i].thread, NULL);
+		r = &chunks[i].res[oCounter->state];
+
+		if (r->comment_newlines != NO_COMMENT) {
+			oCounter->comment_newlines = oCounter->numnewlines + r->comment_newlines;
+		}
+		oCounter->numbytes += chunks[i].len;
+		oCounter->numchars += r->numchars;
+		oCounter->numwords += r->numwords;
+		oCounter->numnewlines += r->numnewlines;
+		oCounter->state = r->state;
+	}
+
+	free(chunks);
+	return TRUE;
+}
+
+int
+Counter_finish (Counter_T oCounter, struct CounterResult *psResult){
+	struct Counter end = *oCounter;
+	int ok = count_finish(&end);
+
+	psResult->lines = count_lines(&end);
+	psResult->words = end.numwords;
+	psResult->chars = end.numchars;
+	psResult->comment_line = end.comment_newlines + 1;
+	return ok;
+}
+
+unsigned long
+Counter_getOffset (Counter_T oCounter){
+	return oCounter->numbytes;
+}
+
+int
+Counter_save (Counter_T oCounter, FILE *fp){
+	fprintf(fp, SAVE_MAGIC " %lu %d %lu %lu %lu %lu\n",
+		oCounter->numbytes, oCounter->state, oCounter->numchars,
+		oCounter->numwords, oCounter->numnewlines,
+		oCounter->comment_newlines);
+	return !ferror(fp);
+}
+
+Counter_T
+Counter_load (FILE *fp){
+	struct Counter saved;
+	Counter_T oCounter;
+
+	if (fscanf(fp, SAVE_MAGIC " %lu %d %lu %lu %lu %lu",
+		   &saved.numbytes, &saved.state, &saved.numchars,
+		   &saved.numwords, &saved.numnewlines,
+		   &saved.comment_newlines) != 6) {
+		return NULL;
+	}
+	if (saved.state < 0 || saved.state >= NUM_STATES) {
+		return NULL;
+	}
+
+	if (!(oCounter = Counter_new())) {
+		return NULL;
+	}
+	*oCounter = saved;
+	return oCounter;
+}
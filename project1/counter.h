@@ -0,0 +1,69 @@
+/*--------------------------------------------------------------------*/
+/* counter.h                                                          */
+/* the comment-aware line/word/char counter behind wc209              */
+/*--------------------------------------------------------------------*/
+
+#ifndef COUNTER_INCLUDED
+#define COUNTER_INCLUDED
+
+#include <stdio.h>
+#include <stddef.h>
+
+/* A Counter_T holds the state of one count. Input can be fed to it in
+   pieces of any size, and the state can be saved and loaded again so
+   that a later run resumes where an earlier one stopped. */
+typedef struct Counter * Counter_T;
+
+/* The counts of a finished input. comment_line is the line of the
+   unterminated comment Counter_finish() failed on. */
+struct CounterResult {
+	unsigned long lines;
+	unsigned long words;
+	unsigned long chars;
+	unsigned long comment_line;
+};
+
+/* Flags for Counter_configure(). */
+#define COUNTER_NO_SIMD 0x1	/* count with the scalar DFA only */
+#define COUNTER_LOCALE  0x2	/* tell spaces with isspace() under the
+				   current locale instead of the C locale */
+
+/* Set the flags every counter runs with. Call it before the first
+   Counter_new(), and before starting threads that create counters. */
+void Counter_configure(int iFlags);
+
+/* Return a new counter at the start of an input, or NULL if
+   insufficient memory is available. */
+Counter_T Counter_new(void);
+
+/* Free oCounter. */
+void Counter_free(Counter_T oCounter);
+
+/* Feed the next len bytes of the input to oCounter. */
+void Counter_feed(Counter_T oCounter, const void *pvBuf, size_t len);
+
+/* Same as Counter_feed(), but split pvBuf among up to iThreads
+   threads. Return 1 (TRUE) if successful, or 0 (FALSE) if a thread
+   could not be started, in which case nothing was fed. */
+int Counter_feedParallel(Counter_T oCounter, const void *pvBuf, size_t len,
+			 int iThreads);
+
+/* Store the counts of the input fed so far in *psResult, as if it
+   ended here. oCounter is left as it was, so more input can still be
+   fed. Return 1 (TRUE) if successful, or 0 (FALSE) if the input ends
+   inside a comment. */
+int Counter_finish(Counter_T oCounter, struct CounterResult *psResult);
+
+/* Return the number of bytes fed to oCounter so far. */
+unsigned long Counter_getOffset(Counter_T oCounter);
+
+/* Write the state of oCounter to fp as one line of text. Return 1
+   (TRUE) if successful, or 0 (FALSE) on a write error. */
+int Counter_save(Counter_T oCounter, FILE *fp);
+
+/* Return a new counter in the state saved by Counter_save() in fp, or
+   NULL if fp does not hold a saved state or insufficient memory is
+   available. */
+Counter_T Counter_load(FILE *fp);
+
+#endif
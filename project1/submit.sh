@@ -1,10 +1,12 @@
 #!/bin/sh
 rm -rf 20180336_assign1
 rm -f 20180336_assign1.tar.gz
-./gcc209 -E wc209.c -o wc209.i
-./gcc209 -S wc209.c -o wc209.s 
-./gcc209 -c wc209.c -o wc209.o
-./gcc209 wc209.c -o wc209
+./gcc209 -D_DEFAULT_SOURCE -E wc209.c -o wc209.i
+./gcc209 -D_DEFAULT_SOURCE -S wc209.c -o wc209.s 
+./gcc209 -D_DEFAULT_SOURCE -c wc209.c -o wc209.o
+./gcc209 -D_DEFAULT_SOURCE -O2 -c counter.c -o counter.o
+./gcc209 -D_DEFAULT_SOURCE -pthread wc209.c counter.o -o wc209
+rm -f counter.o
 mkdir -p 20180336_assign1
-cp wc209.c wc209.i wc209.s wc209.o wc209 readme EthicsOath.pdf dfa.pdf 20180336_assign1
+cp wc209.c counter.c counter.h wc209.i wc209.s wc209.o wc209 readme EthicsOath.pdf dfa.pdf 20180336_assign1
 tar zcf 20180336_assign1.tar.gz 20180336_assign1
@@ -6,249 +6,677 @@ Assignment No.1
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <ctype.h> 
+#include <string.h>
+#include <locale.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <pthread.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include "counter.h"
+
+#define FALSE 0
+#define TRUE  1
+
+/* size of one read() block */
+#define BLOCK_SIZE (1 << 16)
+
+#define MAX_THREADS 256
+
+typedef enum {
+	MODE_GETCHAR,
+	MODE_READ,
+	MODE_MMAP
+} ReadMode;
+
+
+/* reports the comment Counter_finish() failed on. name is NULL for stdin */
+static void
+print_comment_error (const char *name, const struct CounterResult *res){
+	if (name) {
+		fprintf(stderr,"Error: %s: line %lu: unterminated comment\n",
+			name, res->comment_line);
+	}
+	else {
+		fprintf(stderr,"Error: line %lu: unterminated comment\n",
+			res->comment_line);
+	}
+}
 
-int main (int argc, char **argv, char **envp){
-	/* reads a character one by one in a loop and changes state depending on the input character */
-	int state = 0;
-	int prev = 0;
-	int alive = 1;
-	int entered_comment = 0;
-
-	unsigned long comment_entryline = 0;
-	unsigned long numchars = 0;
-	unsigned long numwords = 0;
-	unsigned long numlines = 0;
-
-	char c;
-	int i = 0;
-
-	/* reads characters until EOF */
-	while((c = getchar()) && alive){
-		/*add a line if a character is read from the initial state */
-		//printf("state: %d, char: %c\n",state,c);
-		switch (state) {
-
-			case 0:
-				numlines = 1;
-				prev = 0;
-				if (c == EOF) {
-					alive = 0;
-				}
-
-				else if (isspace(c) && c!='\n'){
-					state = 2;
-				}
-
-				else if (c == '/'){
-
-					state = 4;
-				}
-
-				else if (c == '\n'){
-					state = 3;
-				}
-
-				else {
-					state = 1;
-				}
 
-			break;
+/* the count_*() readers below feed the whole input to the DFA and
+   return FALSE on an I/O error (with errno set), TRUE otherwise.
+   Counter_finish() is left to the caller */
 
-			case 1:
+/* reads characters one by one with getchar() until EOF */
+static int
+count_getchar (Counter_T cnt){
+	int c;
 
-			
-				if (prev != 1 && prev != 4){
-					//printf("reached 1 at %c, numwords=%lu (state = %d, iters = %d)\n",c,numwords,state,i);
-					numwords++;
-				}
-				//printf("%d -> %d (state %d)\n",numchars,numchars+1,state);
-				numchars++;
-				prev = 1;
+	while ((c = getchar()) != EOF) {
+		unsigned char byte = (unsigned char)c;
+		Counter_feed(cnt, &byte, 1);
+	}
+	return !ferror(stdin);
+}
 
-				if (c == EOF) {
-					alive = 0;
-				}
+/* reads fd in BLOCK_SIZE blocks with read() until EOF */
+static int
+count_read (Counter_T cnt, int fd){
+	unsigned char buf[BLOCK_SIZE];
+	ssize_t n;
+
+	while ((n = read(fd, buf, sizeof(buf))) != 0) {
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return FALSE;
+		}
+		Counter_feed(cnt, buf, (size_t)n);
+	}
+	return TRUE;
+}
 
-				else if (isspace(c) && c!='\n'){
-					state = 2;
-				}
+/* maps fd and runs over the whole mapping at once, starting from the
+   current file offset. falls back to count_read() when fd is not a
+   mappable regular file */
+static int
+count_mmap (Counter_T cnt, int fd){
+	struct stat st;
+	off_t off;
+	void *map;
+
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+		return count_read(cnt, fd);
+	}
 
-				else if (c == '/'){
-					state = 4;
-				}
+	off = lseek(fd, 0, SEEK_CUR);
+	if (off < 0 || off >= st.st_size) {
+		return count_read(cnt, fd);
+	}
 
-				else if (c == '\n'){
-					state = 3;
-				}
+	map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) {
+		return count_read(cnt, fd);
+	}
 
-				else {
-					state = 1;
-				}
+	Counter_feed(cnt, (const unsigned char *)map + off,
+		(size_t)(st.st_size - off));
+	munmap(map, (size_t)st.st_size);
 
-			break;
+	/* the file may have grown since fstat(), pick up the rest */
+	if (lseek(fd, st.st_size, SEEK_SET) != st.st_size) {
+		return FALSE;
+	}
+	return count_read(cnt, fd);
+}
 
-			case 2:
-				//printf("%d -> %d (state %d)\n",numchars,numchars+1,state);
-				numchars++;
-				prev = 2;
-				
-				if (c == EOF) {
-					alive = 0;
-				}
 
+/* reads the rest of fd into memory. returns the input in *pbuf and
+   *plen (which the caller must free()), or FALSE on an I/O error */
+static int
+read_input (int fd, unsigned char **pbuf, size_t *plen){
+	unsigned char *buf = NULL;
+	size_t len = 0, cap = 0;
+	ssize_t n;
+
+	do {
+		if (len == cap) {
+			cap = cap ? cap * 2 : BLOCK_SIZE;
+			if (!(buf = realloc(buf, cap))) {
+				fprintf(stderr,"Error: out of memory\n");
+				exit(EXIT_FAILURE);
+			}
+		}
+		if ((n = read(fd, buf + len, cap - len)) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			free(buf);
+			return FALSE;
+		}
+		len += (size_t)n;
+	} while (n != 0);
 
-				else if (isspace(c) && c!='\n'){
-					state = 2;
-				}
+	*pbuf = buf;
+	*plen = len;
+	return TRUE;
+}
 
-				else if (c == '/'){
-					state = 4;
-				}
+/* counts fd with up to nthreads threads. the input is mapped from the
+   current offset like count_mmap() does, or read whole into memory
+   when it can not be mapped */
+static int
+count_parallel (Counter_T cnt, int fd, int nthreads){
+	unsigned char *buf;
+	struct stat st;
+	size_t len;
+	off_t off;
+	int ok;
+
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) &&
+	    (off = lseek(fd, 0, SEEK_CUR)) >= 0 && off < st.st_size) {
+		void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if (map != MAP_FAILED) {
+			ok = Counter_feedParallel(cnt, (const unsigned char *)map + off,
+				(size_t)(st.st_size - off), nthreads);
+			munmap(map, (size_t)st.st_size);
+			if (!ok) {
+				fprintf(stderr,"Error: failed to create a thread\n");
+				exit(EXIT_FAILURE);
+			}
+
+			/* the file may have grown since fstat(), pick up the rest */
+			if (lseek(fd, st.st_size, SEEK_SET) != st.st_size) {
+				return FALSE;
+			}
+			return count_read(cnt, fd);
+		}
+	}
 
-				else if (c == '\n'){
-					state = 3;
-				}
+	if (!read_input(fd, &buf, &len)) {
+		return FALSE;
+	}
+	ok = Counter_feedParallel(cnt, buf, len, nthreads);
+	free(buf);
+	if (!ok) {
+		fprintf(stderr,"Error: failed to create a thread\n");
+		exit(EXIT_FAILURE);
+	}
+	return TRUE;
+}
 
-				else {
-					state = 1;
-				}
+/* outcome of counting one file argument */
+typedef enum {
+	FILE_OK,
+	FILE_OPEN_FAILED,
+	FILE_READ_FAILED,
+	FILE_IS_DIR,
+	FILE_UNTERMINATED
+} FileStatus;
+
+struct file_job {
+	char *name;
+	FileStatus status;
+	int error;		/* errno of FILE_OPEN_FAILED and FILE_READ_FAILED */
+	struct CounterResult res;
+};
+
+/* the file arguments, directories expanded, in output order */
+struct file_list {
+	struct file_job *jobs;
+	size_t len;
+	size_t cap;
+};
+
+/* appends name (which the list then owns) to list */
+static struct file_job *
+add_job (struct file_list *list, char *name){
+	struct file_job *job;
+
+	if (list->len == list->cap) {
+		list->cap = list->cap ? list->cap * 2 : 64;
+		list->jobs = realloc(list->jobs, list->cap * sizeof(*list->jobs));
+		if (!list->jobs) {
+			fprintf(stderr,"Error: out of memory\n");
+			exit(EXIT_FAILURE);
+		}
+	}
 
-			break;
+	job = &list->jobs[list->len++];
+	memset(job, 0, sizeof(*job));
+	job->name = name;
+	job->status = FILE_OK;
+	return job;
+}
 
-			case 3:
+static int
+compare_names (const void *a, const void *b){
+	return strcmp(*(char * const *)a, *(char * const *)b);
+}
 
-				//printf("%d -> %d (state %d)\n",numchars,numchars+1,state);
-				numchars++;
-				numlines++;
-				prev = 3;
+/* adds path to list. with recursive, a directory is replaced by every
+   regular file below it, in name order. symbolic links found while
+   walking are not followed */
+static void
+add_path (struct file_list *list, const char *path, int recursive, int top){
+	struct stat st;
+	char *name = strdup(path);
+	char **names = NULL;
+	size_t n = 0, cap = 0, i;
+	struct dirent *ent;
+	DIR *dir;
+
+	if (!name) {
+		fprintf(stderr,"Error: out of memory\n");
+		exit(EXIT_FAILURE);
+	}
 
-				if (c == EOF) {
-					alive = 0;
-				}
+	if ((top ? stat(path, &st) : lstat(path, &st)) < 0) {
+		struct file_job *job = add_job(list, name);
+		job->status = FILE_OPEN_FAILED;
+		job->error = errno;
+		return;
+	}
 
-				else if (isspace(c) && c!='\n'){
-					state = 2;
-				}
+	if (!S_ISDIR(st.st_mode)) {
+		/* skip sockets, links and the like met while walking */
+		if (top || S_ISREG(st.st_mode)) {
+			add_job(list, name);
+		}
+		else {
+			free(name);
+		}
+		return;
+	}
+
+	if (!recursive) {
+		add_job(list, name)->status = FILE_IS_DIR;
+		return;
+	}
+
+	if (!(dir = opendir(path))) {
+		struct file_job *job = add_job(list, name);
+		job->status = FILE_OPEN_FAILED;
+		job->error = errno;
+		return;
+	}
+
+	while ((ent = readdir(dir))) {
+		size_t len;
+		char *child;
+
+		if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) {
+			continue;
+		}
+
+		len = strlen(path);
+		child = malloc(len + strlen(ent->d_name) + 2);
+		if (!child) {
+			fprintf(stderr,"Error: out of memory\n");
+			exit(EXIT_FAILURE);
+		}
+		strcpy(child, path);
+		if (len == 0 || path[len - 1] != '/') {
+			child[len++] = '/';
+		}
+		strcpy(child + len, ent->d_name);
+
+		if (n == cap) {
+			cap = cap ? cap * 2 : 16;
+			if (!(names = realloc(names, cap * sizeof(*names)))) {
+				fprintf(stderr,"Error: out of memory\n");
+				exit(EXIT_FAILURE);
+			}
+		}
+		names[n++] = child;
+	}
+	closedir(dir);
 
-				else if (c == '/'){
-					state = 4;
-				}
+	qsort(names, n, sizeof(*names), compare_names);
+	for (i = 0; i < n; i++) {
+		add_path(list, names[i], recursive, FALSE);
+		free(names[i]);
+	}
+	free(names);
+	free(name);
+}
+
+/* state shared by the file worker pool */
+struct file_pool {
+	pthread_mutex_t lock;
+	struct file_list *list;
+	size_t next;		/* next job to hand out */
+	ReadMode mode;
+};
+
+/* counts one file into its job */
+static void
+count_file (struct file_job *job, ReadMode mode){
+	Counter_T cnt;
+	int fd;
+	int ok;
+
+	if (job->status != FILE_OK) {
+		return;
+	}
 
-				else if (c == '\n'){
-					state = 3;
-				}
+	if ((fd = open(job->name, O_RDONLY)) < 0) {
+		job->status = FILE_OPEN_FAILED;
+		job->error = errno;
+		return;
+	}
 
-				else {
-					state = 1;
-				}
+	if (!(cnt = Counter_new())) {
+		fprintf(stderr,"Error: out of memory\n");
+		exit(EXIT_FAILURE);
+	}
 
+	ok = (mode == MODE_MMAP) ? count_mmap(cnt, fd) : count_read(cnt, fd);
+	if (!ok) {
+		job->status = (errno == EISDIR) ? FILE_IS_DIR : FILE_READ_FAILED;
+		job->error = errno;
+	}
+	else if (!Counter_finish(cnt, &job->res)) {
+		job->status = FILE_UNTERMINATED;
+	}
+	Counter_free(cnt);
+	close(fd);
+}
+
+static void *
+file_worker (void *arg){
+	struct file_pool *pool = arg;
+
+	while (TRUE) {
+		size_t i;
+
+		pthread_mutex_lock(&pool->lock);
+		i = pool->next++;
+		pthread_mutex_unlock(&pool->lock);
+
+		if (i >= pool->list->len) {
+			return NULL;
+		}
+		count_file(&pool->list->jobs[i], pool->mode);
+	}
+}
+
+/* counts every file of list with nthreads workers, then prints one row
+   per file in argument order and a total row when there is more than
+   one file. returns TRUE if every file was counted */
+static int
+count_files (struct file_list *list, ReadMode mode, int nthreads){
+	static pthread_t threads[MAX_THREADS];
+	struct file_pool pool;
+	unsigned long lines = 0, words = 0, chars = 0;
+	int ret = TRUE;
+	size_t i;
+	int t;
+
+	pthread_mutex_init(&pool.lock, NULL);
+	pool.list = list;
+	pool.next = 0;
+	pool.mode = mode;
+
+	if ((size_t)nthreads > list->len) {
+		nthreads = (int)list->len;
+	}
+	for (t = 1; t < nthreads; t++) {
+		if (pthread_create(&threads[t], NULL, file_worker, &pool)) {
+			fprintf(stderr,"Error: failed to create a thread\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	file_worker(&pool);
+	for (t = 1; t < nthreads; t++) {
+		pthread_join(threads[t], NULL);
+	}
+	pthread_mutex_destroy(&pool.lock);
+
+	for (i = 0; i < list->len; i++) {
+		struct file_job *job = &list->jobs[i];
+
+		switch (job->status) {
+			case FILE_OK:
+				printf("%lu %lu %lu %s\n", job->res.lines,
+					job->res.words, job->res.chars, job->name);
+				lines += job->res.lines;
+				words += job->res.words;
+				chars += job->res.chars;
 			break;
 
-			case 4:
+			case FILE_OPEN_FAILED:
+				fprintf(stderr,"Error: failed to open file %s: %s\n",
+					job->name, strerror(job->error));
+				ret = FALSE;
+			break;
 
-				if (c != '*') {
-					numchars++;
-				}
+			case FILE_READ_FAILED:
+				fprintf(stderr,"Error: failed to read file %s: %s\n",
+					job->name, strerror(job->error));
+				ret = FALSE;
+			break;
 
-				if ((prev == 0 || prev == 2 || prev == 3) && c != '*') {
-					//printf("reached 2 at %c, numwords=%lu (state = %d, iters = %d)\n",c,numwords,state,i);
-					numwords++;
-				}
+			case FILE_IS_DIR:
+				fprintf(stderr,"Error: %s is a directory\n", job->name);
+				ret = FALSE;
+			break;
 
-				prev = 4;
+			case FILE_UNTERMINATED:
+				print_comment_error(job->name, &job->res);
+				ret = FALSE;
+			break;
+		}
+	}
+
+	if (list->len > 1) {
+		printf("%lu %lu %lu total\n", lines, words, chars);
+	}
+	return ret;
+}
 
-				if (c == EOF) {
-					alive = 0;
-				}
+/* loads the counter saved in path and seeks fd to the first byte it has
+   not seen. returns NULL if path does not exist yet, so the count
+   starts over; exits if the state can not be resumed */
+static Counter_T
+resume_counter (const char *path, int fd){
+	Counter_T cnt;
+	struct stat st;
+	off_t off;
+	FILE *fp;
+
+	if (!(fp = fopen(path, "r"))) {
+		if (errno == ENOENT) {
+			return NULL;
+		}
+		fprintf(stderr,"Error: failed to open file %s: %s\n", path, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	cnt = Counter_load(fp);
+	fclose(fp);
 
-				else if (c == '*') {
-					state = 5;
-				}
+	if (!cnt) {
+		fprintf(stderr,"Error: %s does not hold a saved wc209 state\n", path);
+		exit(EXIT_FAILURE);
+	}
 
-				else if (isspace(c) && c!='\n'){
-					state = 2;
-				}
+	off = (off_t)Counter_getOffset(cnt);
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) ||
+	    lseek(fd, off, SEEK_SET) != off) {
+		fprintf(stderr,"Error: -c needs a regular file on stdin\n");
+		exit(EXIT_FAILURE);
+	}
+	if (st.st_size < off) {
+		fprintf(stderr,"Error: stdin is shorter than the state saved in %s\n", path);
+		exit(EXIT_FAILURE);
+	}
+	return cnt;
+}
 
-				else if (c == '/'){
-					state = 4;
-				}
+/* saves cnt to path through a temporary file, so an interrupted run
+   leaves the previous state in place. returns FALSE on failure */
+static int
+save_counter (const char *path, Counter_T cnt){
+	char *tmp = malloc(strlen(path) + sizeof(".tmp"));
+	FILE *fp;
+	int ok;
+
+	if (!tmp) {
+		fprintf(stderr,"Error: out of memory\n");
+		return FALSE;
+	}
+	strcpy(tmp, path);
+	strcat(tmp, ".tmp");
 
-				else if (c == '\n'){
-					state = 3;
-				}
+	if (!(fp = fopen(tmp, "w"))) {
+		fprintf(stderr,"Error: failed to open file %s: %s\n", tmp, strerror(errno));
+		free(tmp);
+		return FALSE;
+	}
+	ok = Counter_save(cnt, fp);
+	ok = (fclose(fp) == 0) && ok;
+	if (!ok || rename(tmp, path) < 0) {
+		fprintf(stderr,"Error: failed to save the state to %s\n", path);
+		remove(tmp);
+		free(tmp);
+		return FALSE;
+	}
+	free(tmp);
+	return TRUE;
+}
 
-				else {
-					state = 1;
-				}
+static void
+print_usage (const char *argv0){
+	fprintf(stderr,"Usage: %s [-g|-r|-m] [-j N] [-s] [-l] [-c STATE | -R] [FILE]...\n"
+		"\t-g: read with getchar()\n"
+		"\t-r: read with read() in blocks (default)\n"
+		"\t-m: map the input with mmap() if possible\n"
+		"\t-j N: count stdin with N threads, or FILEs with a pool of N\n"
+		"\t      threads (one per CPU by default)\n"
+		"\t-R: count every file below the directories among FILEs\n"
+		"\t-c STATE: resume counting stdin from the state saved in STATE\n"
+		"\t          by an earlier run, then save the new state there\n"
+		"\t-s: run the scalar DFA only, without the SIMD fast path\n"
+		"\t-l: tell spaces with isspace() under the locale of the\n"
+		"\t    environment (default: always the C locale)\n", argv0);
+}
 
+int main (int argc, char **argv, char **envp){
+	/* feeds the input to the state machine and prints the counts */
+	Counter_T cnt = NULL;
+	struct CounterResult res;
+	struct file_list files;
+	const char *state_path = NULL;
+	ReadMode mode = MODE_READ;
+	int nthreads = 0;
+	int recursive = FALSE;
+	int simd = TRUE;
+	int use_locale = FALSE;
+	int ret = FALSE;
+	int i;
+
+	memset(&files, 0, sizeof(files));
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-g") == 0) {
+			mode = MODE_GETCHAR;
+		}
+		else if (strcmp(argv[i], "-r") == 0) {
+			mode = MODE_READ;
+		}
+		else if (strcmp(argv[i], "-m") == 0) {
+			mode = MODE_MMAP;
+		}
+		else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+			nthreads = atoi(argv[++i]);
+			if (nthreads < 1 || nthreads > MAX_THREADS) {
+				fprintf(stderr,"Error: -j takes 1 to %d threads\n", MAX_THREADS);
+				return (EXIT_FAILURE);
+			}
+		}
+		else if (strcmp(argv[i], "-s") == 0) {
+			simd = FALSE;
+		}
+		else if (strcmp(argv[i], "-l") == 0) {
+			use_locale = TRUE;
+		}
+		else if (strcmp(argv[i], "-R") == 0) {
+			recursive = TRUE;
+		}
+		else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+			state_path = argv[++i];
+		}
+		else if (argv[i][0] == '-') {
+			print_usage(argv[0]);
+			return (EXIT_FAILURE);
+		}
+		else {
 			break;
+		}
+	}
+
+	/* everything after the options is a file */
+	for (; i < argc; i++) {
+		add_path(&files, argv[i], recursive, TRUE);
+	}
+	if (files.len > 0 && mode == MODE_GETCHAR) {
+		fprintf(stderr,"Error: -g only reads stdin\n");
+		return (EXIT_FAILURE);
+	}
+	if (files.len > 0 && state_path) {
+		fprintf(stderr,"Error: -c only reads stdin\n");
+		return (EXIT_FAILURE);
+	}
+
+	if (use_locale) {
+		setlocale(LC_CTYPE, "");
+	}
+	Counter_configure((simd ? 0 : COUNTER_NO_SIMD) |
+		(use_locale ? COUNTER_LOCALE : 0));
+
+	if (files.len > 0) {
+		if (nthreads == 0) {
+			long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+			nthreads = (ncpu < 1) ? 1 : (ncpu > MAX_THREADS) ? MAX_THREADS : (int)ncpu;
+		}
+		ret = count_files(&files, mode, nthreads);
+		for (i = 0; i < (int)files.len; i++) {
+			free(files.jobs[i].name);
+		}
+		free(files.jobs);
+		return ret ? (EXIT_SUCCESS) : (EXIT_FAILURE);
+	}
 
-			case 5:
-				if (!entered_comment){
-					comment_entryline = numlines;
-					entered_comment = 1;
-				}
-				
-
-				if (prev != 4 && prev != 5 && prev !=6) {
-					fprintf(stderr,"UNREACHABLE CODE!!!\n");
-					exit(-1);
-				}
-				
-				prev = 5;
-
-				if (c == EOF) {
-					alive = 0;
-					fprintf(stderr,"Error: line %lu: unterminated comment\n",comment_entryline);
-					return (EXIT_FAILURE);
-				}
-
-				else if (c == '*') {
-					state = 6;
-				}
-
-				else {
-					if (c == '\n') {
-						numlines++;
-						numchars++;
-					}
-					state = 5;
-				}
+	if (state_path) {
+		cnt = resume_counter(state_path, STDIN_FILENO);
+	}
+	if (!cnt && !(cnt = Counter_new())) {
+		fprintf(stderr,"Error: out of memory\n");
+		return (EXIT_FAILURE);
+	}
 
+	if (nthreads > 0) {
+		ret = count_parallel(cnt, STDIN_FILENO, nthreads);
+	}
+	else {
+		switch (mode) {
+			case MODE_GETCHAR:
+				ret = count_getchar(cnt);
 			break;
 
-			case 6:
-				prev =6;
-
-				if (c == EOF) {
-					alive = 0;
-					fprintf(stderr,"Error: line %lu: unterminated comment\n",comment_entryline);
-					return (EXIT_FAILURE);
-				}
-
-				else if (c == '/') {
-					entered_comment = 0;
-					state = 2;
-				}
-
-				else if (c == '*'){
-					state = 6;
-				}
-				else {
-					if (c == '\n') {
-						numchars++;
-						numlines++;
-					}
-					state = 5;
-				}
+			case MODE_READ:
+				ret = count_read(cnt, STDIN_FILENO);
 			break;
 
+			case MODE_MMAP:
+				ret = count_mmap(cnt, STDIN_FILENO);
+			break;
 		}
-		i++;
 	}
-	printf("%lu %lu %lu\n",numlines,numwords,numchars);
-	return (EXIT_SUCCESS);
 
-	return 0;
+	if (!ret) {
+		perror("read");
+		return (EXIT_FAILURE);
+	}
+
+	/* saved before finishing: a comment still open may close later */
+	if (state_path && !save_counter(state_path, cnt)) {
+		return (EXIT_FAILURE);
+	}
+
+	ret = Counter_finish(cnt, &res);
+	Counter_free(cnt);
+	if (!ret) {
+		print_comment_error(NULL, &res);
+		return (EXIT_FAILURE);
+	}
+
+	printf("%lu %lu %lu\n",res.lines,res.words,res.chars);
+	return (EXIT_SUCCESS);
 }
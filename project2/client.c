@@ -1,6 +1,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include "str.h"
 
 #define MAX_SIZE 100
@@ -10,6 +14,29 @@
 #define STRGETLENGTH_STR "StrGetLength"
 #define STRCONCAT_STR    "StrConcat"
 #define STRSEARCH_STR    "StrSearch"
+#define STRALIGN_STR     "StrAlign"
+#define STRBENCH_STR     "StrBench"
+#define SGREPNUL_STR     "SgrepNul"
+
+/* the alignment test runs every offset and length up to these */
+#define MAX_OFFSET 64
+#define MAX_LENGTH 300
+#define PAGE 4096
+
+/* the benchmark runs each case for at least BENCH_TIME seconds of CPU
+   time, on strings of up to MAX_BENCH bytes */
+#define MAX_BENCH (1 << 20)
+#define BENCH_TIME 0.05
+/* the longest adversarial needle, "aa...ab" */
+#define MAX_NEEDLE 256
+
+/* the null character test runs ./sgrep on an input of this many bytes,
+   enough for -j to split it, in these files */
+#define NUL_INPUT (512 * 1024)
+#define NUL_IN   "sgrep_nul.in"
+#define NUL_READ "sgrep_nul.1"
+#define NUL_MAP  "sgrep_nul.2"
+#define MAX_CMD 256
 
 #define PRINT_RESULT(a) \
   (a) ? printf("Correct!\n") : printf("Wrong!\n")
@@ -284,6 +311,374 @@ TestStrConcat()
   return;
 }
 /*------------------------------------------------------------------*/
+/* sign of a comparison result */
+static int
+Sign(int n)
+{
+  return (n > 0) - (n < 0);
+}
+/*------------------------------------------------------------------*/
+/* checks the Part 1 functions on the strings of length len at offsets
+   off1, off2 of buf1, buf2 against string.h, and counts the failures */
+static int
+CheckAligned(char *buf1, char *buf2, size_t off1, size_t off2, size_t len)
+{
+  char *s1 = buf1 + off1, *s2 = buf2 + off2;
+  char dest[MAX_OFFSET + MAX_LENGTH * 2 + 2];
+  char answer[MAX_OFFSET + MAX_LENGTH * 2 + 2];
+  size_t i;
+  int fails = 0;
+
+  for (i = 0; i < len; i++)
+    s1[i] = s2[i] = 'a' + (i * 7 + off1) % 26;
+  s1[len] = s2[len] = '\0';
+
+  fails += StrGetLength(s1) != strlen(s1);
+  fails += StrCompare(s1, s2) != 0;
+  fails += StrSearch(s1, "") != s1;
+  if (len > 0) {
+    fails += StrSearch(s1, s1 + len - 1) != strstr(s1, s1 + len - 1);
+    fails += StrSearch(s1, s1 + len / 2) != strstr(s1, s1 + len / 2);
+  }
+
+  memset(dest, 'x', sizeof(dest));
+  memset(answer, 'x', sizeof(answer));
+  StrCopy(dest + off2, s1);
+  strcpy(answer + off2, s1);
+  fails += memcmp(dest, answer, sizeof(dest)) != 0;
+  StrConcat(dest + off2, s2);
+  strcat(answer + off2, s2);
+  fails += memcmp(dest, answer, sizeof(dest)) != 0;
+
+  /* a difference at every position, both ways */
+  for (i = 0; i < len; i += 1 + i / 16) {
+    char c = s2[i];
+    s2[i] = (i % 2) ? '~' : '!';
+    fails += Sign(StrCompare(s1, s2)) != Sign(strcmp(s1, s2));
+    fails += Sign(StrCompare(s2, s1)) != Sign(strcmp(s2, s1));
+    s2[i] = '\0';
+    fails += Sign(StrCompare(s1, s2)) != Sign(strcmp(s1, s2));
+    fails += Sign(StrCompare(s2, s1)) != Sign(strcmp(s2, s1));
+    s2[i] = c;
+  }
+
+  /* first-byte scan: the needle's first byte occurs only at the end */
+  if (len > 1) {
+    s1[len - 1] = 'Z';
+    fails += StrSearch(s1, "Z") != s1 + len - 1;
+    fails += StrSearch(s1, "Zq") != NULL;
+    s1[len - 1] = s2[len - 1];
+  }
+  return fails;
+}
+/*------------------------------------------------------------------*/
+/* strings ending right before an unmapped page */
+static int
+CheckPageEnd(void)
+{
+  int fd = open("/dev/zero", O_RDONLY);
+  char *map, *end, *s;
+  size_t len;
+  int fails = 0;
+
+  if (fd < 0)
+    return 0;
+  map = mmap(NULL, 2 * PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return 0;
+  mprotect(map + PAGE, PAGE, PROT_NONE);
+  end = map + PAGE;
+
+  for (len = 0; len < 100; len++) {
+    char other[128];
+    s = end - len - 1;
+    memset(s, 'p', len);
+    s[len] = '\0';
+    memset(other, 'p', len);
+    other[len] = '\0';
+
+    fails += StrGetLength(s) != len;
+    fails += StrCompare(s, other) != 0;
+    fails += StrCompare(other, s) != 0;
+    fails += StrSearch(s, "q") != NULL;
+    fails += StrSearch(other, s) != other;
+  }
+  munmap(map, 2 * PAGE);
+  return fails;
+}
+/*------------------------------------------------------------------*/
+void
+TestStrAlign()
+{
+  static char buf1[MAX_OFFSET + MAX_LENGTH + 1];
+  static char buf2[MAX_OFFSET + MAX_LENGTH + 1];
+  size_t off, len;
+  int fails = 0;
+
+  printf("===========================\n"
+	 "Test StrAlign\n"
+	 "===========================\n");
+
+  /* Test1: every offset of the first string */
+  printf("Test1:\n");
+  for (off = 0; off < MAX_OFFSET; off++)
+    for (len = 0; len <= MAX_LENGTH; len++)
+      fails += CheckAligned(buf1, buf2, off, (off * 5) % MAX_OFFSET, len);
+  PRINT_RESULT(fails == 0);
+
+  /* Test2: every offset of the second string */
+  printf("\nTest2:\n");
+  fails = 0;
+  for (off = 0; off < MAX_OFFSET; off++)
+    for (len = 0; len <= MAX_LENGTH; len++)
+      fails += CheckAligned(buf1, buf2, 0, off, len);
+  PRINT_RESULT(fails == 0);
+
+  /* Test3: strings ending at a page boundary */
+  printf("\nTest3:\n");
+  PRINT_RESULT(CheckPageEnd() == 0);
+  return;
+}
+/*------------------------------------------------------------------*/
+/* the strings a benchmark case runs on: s1 and s2 are equal text of
+   length len, hay is len 'a's and needle the adversarial needle */
+typedef struct Bench {
+  char *s1, *s2, *dest, *hay;
+  const char *needle;
+  size_t len;
+} Bench;
+
+/* keeps the results alive */
+static volatile size_t bench_sink;
+
+static void BenchStrGetLength(Bench *b) { bench_sink += StrGetLength(b->s1); }
+static void BenchStrlen(Bench *b)       { bench_sink += strlen(b->s1); }
+static void BenchStrCopy(Bench *b)      { StrCopy(b->dest, b->s1); }
+static void BenchStrcpy(Bench *b)       { strcpy(b->dest, b->s1); }
+static void BenchStrCompare(Bench *b)   { bench_sink += StrCompare(b->s1, b->s2); }
+static void BenchStrcmp(Bench *b)       { bench_sink += strcmp(b->s1, b->s2); }
+
+/* the first half of s1 is already in dest; the second half is added */
+static void BenchStrConcat(Bench *b)
+{
+  b->dest[b->len / 2] = '\0';
+  StrConcat(b->dest, b->s1 + b->len / 2);
+}
+
+static void BenchStrcat(Bench *b)
+{
+  b->dest[b->len / 2] = '\0';
+  strcat(b->dest, b->s1 + b->len / 2);
+}
+
+/* "zq" never occurs in the text, so the whole of it is scanned */
+static void BenchStrSearch(Bench *b)
+{
+  bench_sink += StrSearch(b->s1, "zq") != NULL;
+}
+
+static void BenchStrstr(Bench *b)
+{
+  bench_sink += strstr(b->s1, "zq") != NULL;
+}
+
+static void BenchStrSearchAdv(Bench *b)
+{
+  bench_sink += StrSearch(b->hay, b->needle) != NULL;
+}
+
+static void BenchStrstrAdv(Bench *b)
+{
+  bench_sink += strstr(b->hay, b->needle) != NULL;
+}
+
+static const struct BenchCase {
+  const char *pcName;
+  void (*pfMine)(Bench *);
+  void (*pfLibc)(Bench *);
+  size_t needle_len; /* of the adversarial needle, 0 for none */
+} benchCases[] = {
+  {"StrGetLength", BenchStrGetLength, BenchStrlen, 0},
+  {"StrCopy", BenchStrCopy, BenchStrcpy, 0},
+  {"StrCompare", BenchStrCompare, BenchStrcmp, 0},
+  {"StrConcat", BenchStrConcat, BenchStrcat, 0},
+  {"StrSearch", BenchStrSearch, BenchStrstr, 0},
+  {"StrSearch a*b/16", BenchStrSearchAdv, BenchStrstrAdv, 16},
+  {"StrSearch a*b/256", BenchStrSearchAdv, BenchStrstrAdv, MAX_NEEDLE},
+};
+
+static const size_t benchLengths[] = {
+  8, 64, 512, 4096, 1 << 16, MAX_BENCH
+};
+
+/* ns per byte of pfRun on b, doubling the repetitions until a batch
+   takes BENCH_TIME, so that clock() is not called for every run */
+static double
+BenchTime(void (*pfRun)(Bench *), Bench *b)
+{
+  clock_t start, elapsed;
+  long reps, i;
+
+  for (reps = 1; ; reps *= 2) {
+    start = clock();
+    for (i = 0; i < reps; i++)
+      pfRun(b);
+    elapsed = clock() - start;
+    if (elapsed >= BENCH_TIME * CLOCKS_PER_SEC)
+      break;
+  }
+  return (double)elapsed * 1e9 / CLOCKS_PER_SEC / reps / b->len;
+}
+/*------------------------------------------------------------------*/
+void
+TestStrBench()
+{
+  static char needle[MAX_NEEDLE + 1];
+  Bench b;
+  size_t i, j, len;
+  double mine, libc;
+
+  printf("===========================\n"
+	 "Test StrBench\n"
+	 "===========================\n");
+
+  b.s1 = malloc(MAX_BENCH + 1);
+  b.s2 = malloc(MAX_BENCH + 1);
+  b.dest = malloc(MAX_BENCH + 1);
+  b.hay = malloc(MAX_BENCH + 1);
+  if (!b.s1 || !b.s2 || !b.dest || !b.hay) {
+    printf("Not enough memory\n");
+    free(b.s1); free(b.s2); free(b.dest); free(b.hay);
+    return;
+  }
+  memset(needle, 'a', MAX_NEEDLE - 1);
+  needle[MAX_NEEDLE - 1] = 'b';
+  needle[MAX_NEEDLE] = '\0';
+
+  printf("%-8s %-18s %12s %12s %7s\n",
+	 "length", "function", "mine ns/B", "libc ns/B", "ratio");
+  for (j = 0; j < sizeof(benchLengths) / sizeof(benchLengths[0]); j++) {
+    len = benchLengths[j];
+    for (i = 0; i < len; i++)
+      b.s1[i] = b.s2[i] = 'a' + (i * 7) % 26;
+    b.s1[len] = b.s2[len] = '\0';
+    memset(b.hay, 'a', len);
+    b.hay[len] = '\0';
+    memcpy(b.dest, b.s1, len / 2);
+    b.len = len;
+
+    for (i = 0; i < sizeof(benchCases) / sizeof(benchCases[0]); i++) {
+      const struct BenchCase *c = &benchCases[i];
+      if (c->needle_len > len)
+	continue;
+      b.needle = needle + MAX_NEEDLE - c->needle_len;
+      mine = BenchTime(c->pfMine, &b);
+      libc = BenchTime(c->pfLibc, &b);
+      printf("%-8lu %-18s %12.3f %12.3f %7.2f\n", (unsigned long)len,
+	     c->pcName, mine, libc, mine / libc);
+    }
+  }
+
+  free(b.s1);
+  free(b.s2);
+  free(b.dest);
+  free(b.hay);
+  return;
+}
+/*------------------------------------------------------------------*/
+/* returns 1 if the files pcFile1 and pcFile2 hold the same bytes */
+static int
+SameFiles(const char *pcFile1, const char *pcFile2)
+{
+  FILE *f1 = fopen(pcFile1, "rb"), *f2 = fopen(pcFile2, "rb");
+  int c1 = 0, c2 = 0;
+
+  if (f1 && f2) {
+    do {
+      c1 = getc(f1);
+      c2 = getc(f2);
+    } while (c1 == c2 && c1 != EOF);
+  }
+  if (f1)
+    fclose(f1);
+  if (f2)
+    fclose(f2);
+  return f1 && f2 && c1 == c2;
+}
+/*------------------------------------------------------------------*/
+/* runs ./sgrep with pcOpts on NUL_IN, once reading it line by line and
+   once with each of the mapped searches, and returns the number of
+   outputs that differ from the one read line by line */
+static int
+CheckMapped(const char *pcOpts)
+{
+  static const char *modes[] = { "-m", "-j 3", "-m -j 8" };
+  char cmd[MAX_CMD];
+  size_t i;
+  int fails = 0;
+
+  sprintf(cmd, "./sgrep %s < %s > %s", pcOpts, NUL_IN, NUL_READ);
+  if (system(cmd) != 0)
+    return 1;
+  for (i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+    sprintf(cmd, "./sgrep %s %s < %s > %s", modes[i], pcOpts, NUL_IN,
+	    NUL_MAP);
+    if (system(cmd) != 0 || !SameFiles(NUL_READ, NUL_MAP)) {
+      printf("Differs: ./sgrep %s %s\n", modes[i], pcOpts);
+      fails++;
+    }
+  }
+  return fails;
+}
+/*------------------------------------------------------------------*/
+void
+TestSgrepNul()
+{
+  /* lines of letters and spaces, some holding null characters */
+  static const char bytes[] = "aab AB\n\n\0";
+  static const char *opts[] = { "", "-c", "-n -b", "-i", "-w" };
+  FILE *f;
+  size_t i;
+  int fails;
+
+  printf("===========================\n"
+	 "Test SgrepNul\n"
+	 "===========================\n");
+
+  if (!(f = fopen(NUL_IN, "wb"))) {
+    printf("Cannot write %s\n", NUL_IN);
+    return;
+  }
+  srand(1);
+  for (i = 0; i < NUL_INPUT; i++)
+    putc(bytes[rand() % (sizeof(bytes) - 1)], f);
+  fclose(f);
+
+  /* Test1: a needle on a line with null characters counts only before
+     the first one, as it does for a line read by fgets() */
+  printf("Test1:\n");
+  fails = 0;
+  for (i = 0; i < sizeof(opts) / sizeof(opts[0]); i++) {
+    char pcOpts[MAX_CMD];
+    sprintf(pcOpts, "%s -f 'ab'", opts[i]);
+    fails += CheckMapped(pcOpts);
+  }
+  PRINT_RESULT(fails == 0);
+
+  /* Test2: a needle holding a newline never runs from one line into
+     the next */
+  printf("\nTest2:\n");
+  fails = CheckMapped("-f \"$(printf 'b\\na')\"") +
+    CheckMapped("-c -f \"$(printf 'a\\n\\nb')\"");
+  PRINT_RESULT(fails == 0);
+
+  remove(NUL_IN);
+  remove(NUL_READ);
+  remove(NUL_MAP);
+  return;
+}
+/*------------------------------------------------------------------*/
 /* PrintUsage()
    print out the usage of the test client                           */
 /*------------------------------------------------------------------*/
@@ -291,7 +686,8 @@ void
 PrintUsage(char* argv0) 
 {
   printf("Test Client Usage:\n");
-  printf("%s [StrGetLength|StrCopy|StrCompare|StrSearch|StrConcat|"
+  printf("%s [StrGetLength|StrCopy|StrCompare|StrSearch|StrConcat|StrAlign|"
+	 "StrBench|SgrepNul]"
 	 "\n", 
 	 argv0);
 }
@@ -319,6 +715,15 @@ main(int argc, char *argv[])
   if (strcmp(argv[1], STRCONCAT_STR) == 0)
     TestStrConcat();
 
+  if (strcmp(argv[1], STRALIGN_STR) == 0)
+    TestStrAlign();
+
+  if (strcmp(argv[1], STRBENCH_STR) == 0)
+    TestStrBench();
+
+  if (strcmp(argv[1], SGREPNUL_STR) == 0)
+    TestSgrepNul();
+
   return 0;
   
 }
@@ -0,0 +1,172 @@
+/* 20180336 송우선
+Assignment.2
+*/
+
+#include <assert.h> /* to use assert() */
+#include <limits.h>
+#include <stdlib.h> /* for malloc() */
+#include "diff.h"
+
+/* the two sequences being compared, and the furthest reaching paths.
+   fd[k] is the largest x reached on diagonal k = x - y going forward,
+   bd[k] the smallest going backward. both are indexed from -(m + 1) */
+struct DiffContext {
+  const unsigned *a, *b;
+  char *del, *ins;
+  long *fd, *bd;
+};
+
+/*finds the middle snake of a[xoff, xlim) and b[yoff, ylim), which differ
+  at both ends, and stores a point on it in *pxmid, *pymid. the two
+  halves of the edit script meet there*/
+static void DiffSplit(struct DiffContext *c, long xoff, long xlim,
+                      long yoff, long ylim, long *pxmid, long *pymid)
+{
+  long *fd = c->fd, *bd = c->bd;
+  long dmin = xoff - ylim, dmax = xlim - yoff;
+  long fmid = xoff - yoff, bmid = xlim - ylim;
+  long fmin = fmid, fmax = fmid, bmin = bmid, bmax = bmid;
+  int odd = (fmid - bmid) & 1;
+  long d;
+
+  fd[fmid] = xoff;
+  bd[bmid] = xlim;
+
+  for (;;) {
+    /* one step forward on every diagonal in reach */
+    if (fmin > dmin) {
+      fd[--fmin - 1] = -1;
+    }
+    else {
+      fmin++;
+    }
+    if (fmax < dmax) {
+      fd[++fmax + 1] = -1;
+    }
+    else {
+      fmax--;
+    }
+    for (d = fmax; d >= fmin; d -= 2) {
+      long x, y;
+
+      x = (fd[d - 1] >= fd[d + 1]) ? fd[d - 1] + 1 : fd[d + 1];
+      y = x - d;
+      while (x < xlim && y < ylim && c->a[x] == c->b[y]) {
+        x++;
+        y++;
+      }
+      fd[d] = x;
+      if (odd && bmin <= d && d <= bmax && bd[d] <= x) {
+        *pxmid = x;
+        *pymid = y;
+        return;
+      }
+    }
+
+    /* and one backward */
+    if (bmin > dmin) {
+      bd[--bmin - 1] = LONG_MAX;
+    }
+    else {
+      bmin++;
+    }
+    if (bmax < dmax) {
+      bd[++bmax + 1] = LONG_MAX;
+    }
+    else {
+      bmax--;
+    }
+    for (d = bmax; d >= bmin; d -= 2) {
+      long x, y;
+
+      x = (bd[d - 1] < bd[d + 1]) ? bd[d - 1] : bd[d + 1] - 1;
+      y = x - d;
+      while (x > xoff && y > yoff && c->a[x - 1] == c->b[y - 1]) {
+        x--;
+        y--;
+      }
+      bd[d] = x;
+      if (!odd && fmin <= d && d <= fmax && x <= fd[d]) {
+        *pxmid = x;
+        *pymid = y;
+        return;
+      }
+    }
+  }
+}
+
+/*marks the difference of a[xoff, xlim) and b[yoff, ylim). the first half
+  is done by recursion and the second by the loop*/
+static void DiffCompare(struct DiffContext *c, long xoff, long xlim,
+                        long yoff, long ylim)
+{
+  for (;;) {
+    long xmid, ymid;
+
+    /* the common ends are in every common subsequence */
+    while (xoff < xlim && yoff < ylim && c->a[xoff] == c->b[yoff]) {
+      xoff++;
+      yoff++;
+    }
+    while (xoff < xlim && yoff < ylim &&
+           c->a[xlim - 1] == c->b[ylim - 1]) {
+      xlim--;
+      ylim--;
+    }
+
+    if (xoff == xlim) {
+      while (yoff < ylim) {
+        c->ins[yoff++] = 1;
+      }
+      return;
+    }
+    if (yoff == ylim) {
+      while (xoff < xlim) {
+        c->del[xoff++] = 1;
+      }
+      return;
+    }
+
+    DiffSplit (c, xoff, xlim, yoff, ylim, &xmid, &ymid);
+    DiffCompare (c, xoff, xmid, yoff, ymid);
+    xoff = xmid;
+    yoff = ymid;
+  }
+}
+
+int Diff_mark(const unsigned *a, size_t n, const unsigned *b, size_t m,
+              char *del, char *ins)
+{
+  struct DiffContext c;
+  long *v;
+  size_t i;
+
+  assert (a || n == 0);
+  assert (b || m == 0);
+  assert (del || n == 0);
+  assert (ins || m == 0);
+
+  for (i = 0; i < n; i++) {
+    del[i] = 0;
+  }
+  for (i = 0; i < m; i++) {
+    ins[i] = 0;
+  }
+
+  /* diagonals run from -(m + 1) to n + 1 */
+  v = malloc (2 * (n + m + 3) * sizeof(long));
+  if (!v) {
+    return 0;
+  }
+  c.a = a;
+  c.b = b;
+  c.del = del;
+  c.ins = ins;
+  c.fd = v + m + 1;
+  c.bd = v + (n + m + 3) + m + 1;
+
+  DiffCompare (&c, 0, (long)n, 0, (long)m);
+
+  free (v);
+  return 1;
+}
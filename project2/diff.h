@@ -0,0 +1,15 @@
+#ifndef _DIFF_H_
+#define _DIFF_H_
+#include <unistd.h> /* for typedef of size_t */
+
+/* Myers' O(ND) difference of two sequences of integers, such as lines
+   numbered so that equal lines share a number. it runs in linear space,
+   splitting at the middle snake of each edit script.
+
+   sets del[i] for each element of a, and ins[j] for each element of b,
+   that is not in the longest common subsequence found, and clears the
+   others. returns 0 if insufficient memory is available */
+int Diff_mark(const unsigned *a, size_t n, const unsigned *b, size_t m,
+              char *del, char *ins);
+
+#endif /* _DIFF_H_ */
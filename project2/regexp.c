@@ -0,0 +1,807 @@
+/* 20180336 송우선
+Assignment.2
+*/
+
+#include <assert.h> /* to use assert() */
+#include <stdlib.h> /* for malloc() */
+#include <string.h>
+#include "regexp.h"
+
+/* limits on the size of a compiled expression and of its DFA. when the
+   DFA is full it is dropped and built again from the state it is in */
+#define MAX_NFA_NODES 20000
+#define MAX_REPEAT 255
+#define MAX_DFA_STATES 1024
+#define REPEAT_INF -1
+
+#define SET_HAS(set, c) ((set)[(c) >> 3] & (1 << ((c) & 7)))
+#define SET_ADD(set, c) ((set)[(c) >> 3] |= (unsigned char)(1 << ((c) & 7)))
+
+/* Parsing */
+/*------------------------------------------------------------------------*/
+/* the parser builds a tree of these, which is compiled to the NFA */
+enum AstType { AST_SET, AST_CAT, AST_ALT, AST_REPEAT, AST_BOL, AST_EOL,
+               AST_EMPTY };
+
+struct Ast {
+  enum AstType type;
+  int left, right;          /* operands of CAT and ALT, left of REPEAT */
+  int min, max;             /* REPEAT bounds, max may be REPEAT_INF */
+  unsigned char set[32];    /* the bytes of a SET */
+};
+
+struct Parser {
+  const char *p;            /* the rest of the pattern */
+  int flags;
+  struct Ast *nodes;
+  int n, cap;
+  const char *pcError;
+};
+
+static int ParseAlt(struct Parser *ps);
+
+/*adds a node of type, returns its index or -1 if out of memory*/
+static int NewAst(struct Parser *ps, enum AstType type)
+{
+  struct Ast *a;
+
+  if (ps->n == ps->cap) {
+    int cap = ps->cap ? 2 * ps->cap : 64;
+    a = realloc (ps->nodes, cap * sizeof(*a));
+    if (!a) {
+      ps->pcError = "out of memory";
+      return -1;
+    }
+    ps->nodes = a;
+    ps->cap = cap;
+  }
+
+  a = &ps->nodes[ps->n];
+  memset (a, 0, sizeof(*a));
+  a->type = type;
+  return ps->n++;
+}
+
+/*adds a node joining left and right by type, CAT or ALT*/
+static int NewPair(struct Parser *ps, enum AstType type, int left, int right)
+{
+  int i = NewAst (ps, type);
+
+  if (i >= 0) {
+    ps->nodes[i].left = left;
+    ps->nodes[i].right = right;
+  }
+  return i;
+}
+
+/*adds the bytes of the class escape \c, one of dDwWsS, to set. returns
+  0 if c is no such escape*/
+static int AddClassEscape(unsigned char *set, int c)
+{
+  unsigned char class[32];
+  int i;
+
+  memset (class, 0, sizeof(class));
+  switch (c | 0x20) {
+  case 'd':
+    for (i = '0'; i <= '9'; i++) {
+      SET_ADD (class, i);
+    }
+    break;
+  case 'w':
+    for (i = 0; i < 256; i++) {
+      if ((i >= 'a' && i <= 'z') || (i >= 'A' && i <= 'Z') ||
+          (i >= '0' && i <= '9') || i == '_') {
+        SET_ADD (class, i);
+      }
+    }
+    break;
+  case 's':
+    for (i = '\t'; i <= '\r'; i++) {
+      SET_ADD (class, i);
+    }
+    SET_ADD (class, ' ');
+    break;
+  default:
+    return 0;
+  }
+
+  /* the capital letter is the complement */
+  for (i = 0; i < 32; i++) {
+    set[i] |= (c >= 'a') ? class[i] : (unsigned char)~class[i];
+  }
+  return 1;
+}
+
+/*returns the byte an escape \c stands for outside a class escape*/
+static int EscapedByte(int c)
+{
+  switch (c) {
+  case 't':
+    return '\t';
+  case 'n':
+    return '\n';
+  default:
+    return c;
+  }
+}
+
+/*adds the other case of each letter of set*/
+static void FoldSet(unsigned char *set)
+{
+  int c;
+
+  for (c = 'a'; c <= 'z'; c++) {
+    if (SET_HAS (set, c) || SET_HAS (set, c - 'a' + 'A')) {
+      SET_ADD (set, c);
+      SET_ADD (set, c - 'a' + 'A');
+    }
+  }
+}
+
+/*parses a class after its '['*/
+static int ParseClass(struct Parser *ps)
+{
+  unsigned char set[32];
+  int negate = 0, first = 1, i;
+
+  memset (set, 0, sizeof(set));
+  if (*ps->p == '^') {
+    negate = 1;
+    ps->p++;
+  }
+
+  /* a ']' right after the '[' or '[^' is a member */
+  while (first || *ps->p != ']') {
+    int lo, hi;
+
+    first = 0;
+    if (!*ps->p) {
+      ps->pcError = "missing ]";
+      return -1;
+    }
+    lo = (unsigned char)*ps->p++;
+    if (lo == '\\') {
+      if (!*ps->p) {
+        ps->pcError = "trailing \\";
+        return -1;
+      }
+      lo = (unsigned char)*ps->p++;
+      if (AddClassEscape (set, lo)) {
+        continue;
+      }
+      lo = EscapedByte (lo);
+    }
+
+    hi = lo;
+    if (ps->p[0] == '-' && ps->p[1] && ps->p[1] != ']') {
+      ps->p++;
+      hi = (unsigned char)*ps->p++;
+      if (hi == '\\') {
+        if (!*ps->p) {
+          ps->pcError = "trailing \\";
+          return -1;
+        }
+        hi = EscapedByte ((unsigned char)*ps->p++);
+      }
+      if (hi < lo) {
+        ps->pcError = "invalid range";
+        return -1;
+      }
+    }
+    for (i = lo; i <= hi; i++) {
+      SET_ADD (set, i);
+    }
+  }
+  ps->p++;
+
+  if (ps->flags & REGEXP_ICASE) {
+    FoldSet (set);
+  }
+  if (negate) {
+    for (i = 0; i < 32; i++) {
+      set[i] = ~set[i];
+    }
+  }
+
+  if ((i = NewAst (ps, AST_SET)) >= 0) {
+    memcpy (ps->nodes[i].set, set, sizeof(set));
+  }
+  return i;
+}
+
+/*parses one atom: a byte, a class, a group or an anchor*/
+static int ParseAtom(struct Parser *ps)
+{
+  int c = (unsigned char)*ps->p++;
+  int i;
+
+  switch (c) {
+  case '(':
+    if ((i = ParseAlt (ps)) < 0) {
+      return -1;
+    }
+    if (*ps->p != ')') {
+      ps->pcError = "missing )";
+      return -1;
+    }
+    ps->p++;
+    return i;
+  case '[':
+    return ParseClass (ps);
+  case '^':
+    return NewAst (ps, AST_BOL);
+  case '$':
+    return NewAst (ps, AST_EOL);
+  case '*':
+  case '+':
+  case '?':
+    ps->pcError = "nothing to repeat";
+    return -1;
+  }
+
+  if ((i = NewAst (ps, AST_SET)) < 0) {
+    return -1;
+  }
+  if (c == '.') {
+    memset (ps->nodes[i].set, 0xff, 32);
+    return i;
+  }
+  if (c == '\\') {
+    if (!*ps->p) {
+      ps->pcError = "trailing \\";
+      return -1;
+    }
+    c = (unsigned char)*ps->p++;
+    if (AddClassEscape (ps->nodes[i].set, c)) {
+      return i;
+    }
+    c = EscapedByte (c);
+  }
+  SET_ADD (ps->nodes[i].set, c);
+  if (ps->flags & REGEXP_ICASE) {
+    FoldSet (ps->nodes[i].set);
+  }
+  return i;
+}
+
+/*reads a bound {m}, {m,} or {m,n} into *pmin and *pmax. returns 0 and
+  leaves the pattern alone if there is none, as '{' is then a byte*/
+static int ParseBound(struct Parser *ps, int *pmin, int *pmax)
+{
+  const char *p = ps->p + 1;
+  int min = 0, max;
+
+  if (*p < '0' || *p > '9') {
+    return 0;
+  }
+  /* past MAX_REPEAT the count only has to stay too large */
+  for (; *p >= '0' && *p <= '9'; p++) {
+    if (min <= MAX_REPEAT) {
+      min = min * 10 + (*p - '0');
+    }
+  }
+  max = min;
+  if (*p == ',') {
+    p++;
+    max = REPEAT_INF;
+    if (*p >= '0' && *p <= '9') {
+      max = 0;
+      for (; *p >= '0' && *p <= '9'; p++) {
+        if (max <= MAX_REPEAT) {
+          max = max * 10 + (*p - '0');
+        }
+      }
+    }
+  }
+  if (*p != '}') {
+    return 0;
+  }
+
+  ps->p = p + 1;
+  *pmin = min;
+  *pmax = max;
+  return 1;
+}
+
+/*parses an atom and the repetitions after it*/
+static int ParseRepeat(struct Parser *ps)
+{
+  int i = ParseAtom (ps);
+
+  while (i >= 0) {
+    int min, max, r;
+
+    if (*ps->p == '*') {
+      min = 0;
+      max = REPEAT_INF;
+      ps->p++;
+    }
+    else if (*ps->p == '+') {
+      min = 1;
+      max = REPEAT_INF;
+      ps->p++;
+    }
+    else if (*ps->p == '?') {
+      min = 0;
+      max = 1;
+      ps->p++;
+    }
+    else if (*ps->p == '{' && ParseBound (ps, &min, &max)) {
+      if (min > MAX_REPEAT || max > MAX_REPEAT) {
+        ps->pcError = "repetition count too large";
+        return -1;
+      }
+      if (max != REPEAT_INF && max < min) {
+        ps->pcError = "invalid repetition count";
+        return -1;
+      }
+    }
+    else {
+      break;
+    }
+
+    if ((r = NewAst (ps, AST_REPEAT)) < 0) {
+      return -1;
+    }
+    ps->nodes[r].left = i;
+    ps->nodes[r].min = min;
+    ps->nodes[r].max = max;
+    i = r;
+  }
+  return i;
+}
+
+/*parses a sequence up to a '|', a ')' or the end*/
+static int ParseCat(struct Parser *ps)
+{
+  int i = -1;
+
+  while (*ps->p && *ps->p != '|' && *ps->p != ')') {
+    int r = ParseRepeat (ps);
+
+    if (r < 0) {
+      return -1;
+    }
+    if (i >= 0 && (r = NewPair (ps, AST_CAT, i, r)) < 0) {
+      return -1;
+    }
+    i = r;
+  }
+  return (i >= 0) ? i : NewAst (ps, AST_EMPTY);
+}
+
+/*parses alternatives separated by '|'*/
+static int ParseAlt(struct Parser *ps)
+{
+  int i = ParseCat (ps);
+
+  while (i >= 0 && *ps->p == '|') {
+    int r;
+
+    ps->p++;
+    if ((r = ParseCat (ps)) < 0) {
+      return -1;
+    }
+    i = NewPair (ps, AST_ALT, i, r);
+  }
+  return i;
+}
+
+/* NFA */
+/*------------------------------------------------------------------------*/
+enum NfaType { NFA_SET, NFA_SPLIT, NFA_BOL, NFA_EOL, NFA_MATCH };
+
+struct NfaNode {
+  enum NfaType type;
+  int out, out1;            /* out1 only for SPLIT */
+  unsigned char set[32];    /* the bytes a SET moves on */
+};
+
+/* a DFA state: the NFA nodes it stands for, sorted, and its transitions,
+   -1 until first taken */
+struct DfaState {
+  int next[256];
+  int match;                /* holds the MATCH node */
+  int eol_match;            /* reaches MATCH at the end of the text */
+  unsigned hash;
+  int n;
+  int nodes[];
+};
+
+struct Regexp {
+  struct NfaNode *nfa;
+  int nnfa, nfacap;
+  int start;
+
+  struct DfaState **states;
+  int nstates;
+  int table[2 * MAX_DFA_STATES];  /* open addressing, state + 1 or 0 */
+  int initial;              /* -1 until built */
+  int initial_eol;          /* whether an empty text matches */
+  int flushed;              /* the last AddState() dropped the DFA */
+
+  /* scratch for building a state */
+  int *set, *stack;
+  unsigned *mark;
+  unsigned gen;
+};
+
+/*adds a node, returns its index or -1 if the NFA is full*/
+static int NewNfa(Regexp_T re, enum NfaType type, int out, int out1)
+{
+  struct NfaNode *node;
+
+  if (re->nnfa == MAX_NFA_NODES) {
+    return -1;
+  }
+  if (re->nnfa == re->nfacap) {
+    int cap = re->nfacap ? 2 * re->nfacap : 64;
+    if (cap > MAX_NFA_NODES) {
+      cap = MAX_NFA_NODES;
+    }
+    node = realloc (re->nfa, cap * sizeof(*node));
+    if (!node) {
+      return -1;
+    }
+    re->nfa = node;
+    re->nfacap = cap;
+  }
+
+  node = &re->nfa[re->nnfa];
+  node->type = type;
+  node->out = out;
+  node->out1 = out1;
+  return re->nnfa++;
+}
+
+/*compiles the tree at a into nodes that go on to next, back to front, so
+  each node is made knowing where it leads. returns the first node*/
+static int Compile(Regexp_T re, const struct Ast *nodes, int a, int next)
+{
+  const struct Ast *ast = &nodes[a];
+  int i, s, t;
+
+  switch (ast->type) {
+  case AST_SET:
+    if ((s = NewNfa (re, NFA_SET, next, -1)) >= 0) {
+      memcpy (re->nfa[s].set, ast->set, 32);
+    }
+    return s;
+  case AST_CAT:
+    if ((t = Compile (re, nodes, ast->right, next)) < 0) {
+      return -1;
+    }
+    return Compile (re, nodes, ast->left, t);
+  case AST_ALT:
+    if ((s = Compile (re, nodes, ast->left, next)) < 0 ||
+        (t = Compile (re, nodes, ast->right, next)) < 0) {
+      return -1;
+    }
+    return NewNfa (re, NFA_SPLIT, s, t);
+  case AST_BOL:
+    return NewNfa (re, NFA_BOL, next, -1);
+  case AST_EOL:
+    return NewNfa (re, NFA_EOL, next, -1);
+  case AST_EMPTY:
+    return next;
+  case AST_REPEAT:
+    break;
+  }
+
+  /* a{m,n} is m copies of a, then n - m nested optional ones, or a loop
+     for a{m,} */
+  t = next;
+  if (ast->max == REPEAT_INF) {
+    if ((s = NewNfa (re, NFA_SPLIT, -1, next)) < 0 ||
+        (t = Compile (re, nodes, ast->left, s)) < 0) {
+      return -1;
+    }
+    re->nfa[s].out = t;
+    t = s;
+  }
+  else {
+    for (i = ast->min; i < ast->max; i++) {
+      if ((s = Compile (re, nodes, ast->left, t)) < 0 ||
+          (t = NewNfa (re, NFA_SPLIT, s, next)) < 0) {
+        return -1;
+      }
+    }
+  }
+  for (i = 0; i < ast->min; i++) {
+    if ((t = Compile (re, nodes, ast->left, t)) < 0) {
+      return -1;
+    }
+  }
+  return t;
+}
+
+Regexp_T Regexp_new(const char *pcPattern, int flags, const char **ppcError)
+{
+  struct Parser ps;
+  Regexp_T re;
+  int root, match;
+
+  assert (pcPattern);
+  assert (ppcError);
+
+  memset (&ps, 0, sizeof(ps));
+  ps.p = pcPattern;
+  ps.flags = flags;
+  if ((root = ParseAlt (&ps)) >= 0 && *ps.p == ')') {
+    ps.pcError = "unmatched )";
+    root = -1;
+  }
+  if (root < 0) {
+    free (ps.nodes);
+    *ppcError = ps.pcError;
+    return NULL;
+  }
+
+  *ppcError = "out of memory";
+  if (!(re = calloc (1, sizeof(*re)))) {
+    free (ps.nodes);
+    return NULL;
+  }
+  re->initial = -1;
+
+  if ((match = NewNfa (re, NFA_MATCH, -1, -1)) < 0 ||
+      (re->start = Compile (re, ps.nodes, root, match)) < 0) {
+    if (re->nnfa >= MAX_NFA_NODES) {
+      *ppcError = "expression too large";
+    }
+    free (ps.nodes);
+    Regexp_free (re);
+    return NULL;
+  }
+  free (ps.nodes);
+
+  re->states = malloc (MAX_DFA_STATES * sizeof(*re->states));
+  re->set = malloc (re->nnfa * sizeof(int));
+  re->stack = malloc (re->nnfa * sizeof(int));
+  re->mark = calloc (re->nnfa, sizeof(unsigned));
+  if (!re->states || !re->set || !re->stack || !re->mark) {
+    Regexp_free (re);
+    return NULL;
+  }
+
+  *ppcError = NULL;
+  return re;
+}
+
+/*drops every DFA state*/
+static void FlushStates(Regexp_T re)
+{
+  int i;
+
+  for (i = 0; i < re->nstates; i++) {
+    free (re->states[i]);
+  }
+  re->nstates = 0;
+  re->initial = -1;
+  memset (re->table, 0, sizeof(re->table));
+}
+
+void Regexp_free(Regexp_T oRegexp)
+{
+  if (!oRegexp) {
+    return;
+  }
+  if (oRegexp->states) {
+    FlushStates (oRegexp);
+  }
+  free (oRegexp->states);
+  free (oRegexp->nfa);
+  free (oRegexp->set);
+  free (oRegexp->stack);
+  free (oRegexp->mark);
+  free (oRegexp);
+}
+
+/* DFA */
+/*------------------------------------------------------------------------*/
+/*adds to re->set the nodes that node leads to without reading a byte:
+  the SET and MATCH nodes, and the EOL nodes unless at_end follows them.
+  BOL is followed only at_start. nodes marked with re->gen are already
+  in*/
+static void Closure(Regexp_T re, int node, int at_start, int at_end,
+                    int *pn)
+{
+  int sp = 0;
+
+  if (re->mark[node] == re->gen) {
+    return;
+  }
+  re->mark[node] = re->gen;
+  re->stack[sp++] = node;
+
+  while (sp > 0) {
+    struct NfaNode *nn = &re->nfa[re->stack[--sp]];
+    int follow[2], nfollow = 0, i;
+
+    switch (nn->type) {
+    case NFA_SPLIT:
+      follow[nfollow++] = nn->out;
+      follow[nfollow++] = nn->out1;
+      break;
+    case NFA_BOL:
+      if (at_start) {
+        follow[nfollow++] = nn->out;
+      }
+      break;
+    case NFA_EOL:
+      if (at_end) {
+        follow[nfollow++] = nn->out;
+      }
+      else {
+        re->set[(*pn)++] = nn - re->nfa;
+      }
+      break;
+    case NFA_SET:
+    case NFA_MATCH:
+      re->set[(*pn)++] = nn - re->nfa;
+      break;
+    }
+
+    for (i = 0; i < nfollow; i++) {
+      if (re->mark[follow[i]] != re->gen) {
+        re->mark[follow[i]] = re->gen;
+        re->stack[sp++] = follow[i];
+      }
+    }
+  }
+}
+
+/*returns whether the nodes of state st, entered at_start, reach MATCH at
+  the end of the text. uses re->set*/
+static int MatchesAtEnd(Regexp_T re, const struct DfaState *st, int at_start)
+{
+  int i, m = 0;
+
+  if (st->match) {
+    return 1;
+  }
+  re->gen++;
+  for (i = 0; i < st->n; i++) {
+    if (re->nfa[st->nodes[i]].type == NFA_EOL) {
+      Closure (re, re->nfa[st->nodes[i]].out, at_start, 1, &m);
+    }
+  }
+  for (i = 0; i < m; i++) {
+    if (re->nfa[re->set[i]].type == NFA_MATCH) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static int CompareInt(const void *a, const void *b)
+{
+  return *(const int *)a - *(const int *)b;
+}
+
+/*returns the state for the n nodes of re->set, made if new. when the
+  DFA is full it is flushed first, and re->flushed set. returns -1 if out
+  of memory*/
+static int AddState(Regexp_T re, int n)
+{
+  struct DfaState *st;
+  unsigned hash = 2166136261U;
+  int i, h;
+
+  qsort (re->set, n, sizeof(int), CompareInt);
+  for (i = 0; i < n; i++) {
+    hash = (hash ^ (unsigned)re->set[i]) * 16777619U;
+  }
+
+  for (h = hash & (2 * MAX_DFA_STATES - 1); re->table[h];
+       h = (h + 1) & (2 * MAX_DFA_STATES - 1)) {
+    st = re->states[re->table[h] - 1];
+    if (st->hash == hash && st->n == n &&
+        !memcmp (st->nodes, re->set, n * sizeof(int))) {
+      return re->table[h] - 1;
+    }
+  }
+
+  re->flushed = 0;
+  if (re->nstates == MAX_DFA_STATES) {
+    FlushStates (re);
+    re->flushed = 1;
+    for (h = hash & (2 * MAX_DFA_STATES - 1); re->table[h];
+         h = (h + 1) & (2 * MAX_DFA_STATES - 1))
+      ;
+  }
+
+  if (!(st = malloc (sizeof(*st) + n * sizeof(int)))) {
+    return -1;
+  }
+  for (i = 0; i < 256; i++) {
+    st->next[i] = -1;
+  }
+  st->hash = hash;
+  st->n = n;
+  memcpy (st->nodes, re->set, n * sizeof(int));
+  st->match = 0;
+  for (i = 0; i < n; i++) {
+    if (re->nfa[st->nodes[i]].type == NFA_MATCH) {
+      st->match = 1;
+    }
+  }
+  st->eol_match = MatchesAtEnd (re, st, 0);
+
+  re->states[re->nstates] = st;
+  re->table[h] = ++re->nstates;
+  return re->nstates - 1;
+}
+
+/*returns the state at the start of a text*/
+static int InitialState(Regexp_T re)
+{
+  int n = 0;
+
+  if (re->initial >= 0) {
+    return re->initial;
+  }
+  re->gen++;
+  Closure (re, re->start, 1, 0, &n);
+  if ((re->initial = AddState (re, n)) >= 0) {
+    re->initial_eol = MatchesAtEnd (re, re->states[re->initial], 1);
+  }
+  return re->initial;
+}
+
+/*returns the state after state s reads the byte c, and records it in s.
+  a match may start at any byte, so the start node is added too*/
+static int NextState(Regexp_T re, int s, int c)
+{
+  struct DfaState *st = re->states[s];
+  int i, n = 0, t;
+
+  re->gen++;
+  for (i = 0; i < st->n; i++) {
+    struct NfaNode *nn = &re->nfa[st->nodes[i]];
+    if (nn->type == NFA_SET && SET_HAS (nn->set, c)) {
+      Closure (re, nn->out, 0, 0, &n);
+    }
+  }
+  Closure (re, re->start, 0, 0, &n);
+
+  /* a flush frees st, and the edge with it */
+  if ((t = AddState (re, n)) >= 0 && !re->flushed) {
+    st->next[c] = t;
+  }
+  return t;
+}
+
+int Regexp_match(Regexp_T oRegexp, const char *pcText, size_t len)
+{
+  const unsigned char *p = (const unsigned char *)pcText;
+  size_t i;
+  int s;
+
+  assert (oRegexp);
+  assert (pcText);
+
+  if ((s = InitialState (oRegexp)) < 0) {
+    return -1;
+  }
+  if (len == 0) {
+    return oRegexp->initial_eol;
+  }
+  if (oRegexp->states[s]->match) {
+    return 1;
+  }
+
+  for (i = 0; i < len; i++) {
+    int t = oRegexp->states[s]->next[p[i]];
+
+    if (t < 0 && (t = NextState (oRegexp, s, p[i])) < 0) {
+      return -1;
+    }
+    s = t;
+    if (oRegexp->states[s]->match) {
+      return 1;
+    }
+  }
+  return oRegexp->states[s]->eol_match;
+}
@@ -0,0 +1,34 @@
+#ifndef _REGEXP_H_
+#define _REGEXP_H_
+#include <unistd.h> /* for typedef of size_t */
+
+/* a regular expression compiled to an NFA, and run as a DFA whose states
+   are built the first time they are reached and kept for later texts.
+
+   the syntax is that of extended regular expressions:
+     c        the byte c, or \c for any of  . [ ] ( ) | * + ? { } ^ $ \
+     .        any byte
+     [abc]    a class, with ranges as in [a-z] and [^...] for the rest
+     \d \w \s digits, word bytes and white space, \D \W \S the rest
+     \t \n    tab and newline
+     ab       a, then b
+     a|b      a or b
+     (a)      grouping
+     a* a+ a? a, repeated any times, at least once, or at most once
+     a{m} a{m,} a{m,n}
+              a, repeated m times, at least m, or m to n times
+     ^ $      the start and the end of the text */
+typedef struct Regexp *Regexp_T;
+
+/* flags: letters match in either case (ASCII only) */
+#define REGEXP_ICASE 0x1
+
+/* compiles pcPattern. returns NULL and points *ppcError to what was
+   wrong, or "out of memory" */
+Regexp_T Regexp_new(const char *pcPattern, int flags, const char **ppcError);
+void Regexp_free(Regexp_T oRegexp);
+/* returns 1 if the len bytes at pcText hold a match, 0 if not, and -1 if
+   insufficient memory is available to build a state */
+int Regexp_match(Regexp_T oRegexp, const char *pcText, size_t len);
+
+#endif /* _REGEXP_H_ */
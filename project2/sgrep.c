@@ -5,14 +5,62 @@ Assignment.2
 #include <stdlib.h>
 #include <string.h> /* for skeleton code */
 #include <unistd.h> /* for getopt */
+#include <errno.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/uio.h>  /* for writev */
 #include "str.h"
+#include "diff.h"
+#include "regexp.h"
+#include "zread.h"
 
 #define FIND_STR        "-f"
 #define REPLACE_STR     "-r"
 #define DIFF_STR        "-d"
+#define MULTIFIND_STR   "-F"
+#define REGEX_STR       "-E"
+#define INPLACE_STR     "-R"
+#define RULES_STR       "-S"
+
+#define MMAP_OPT_STR    "-m"
+#define PATFILE_OPT_STR "-p"
+#define TAG_OPT_STR     "-t"
+#define JOBS_OPT_STR    "-j"
+#define UNIFIED_OPT_STR "-u"
+#define ICASE_OPT_STR   "-i"
+#define WORD_OPT_STR    "-w"
+#define COUNT_OPT_STR   "-c"
+#define NUMBER_OPT_STR  "-n"
+#define OFFSET_OPT_STR  "-b"
 
 #define MAX_STR_LEN 1023
 
+/* number of lines gathered before one writev() */
+#define MAX_IOV 1024
+
+/* -j: the most threads, and the least bytes a chunk is split down to */
+#define MAX_THREADS 64
+#define MIN_CHUNK (64 * 1024)
+#define CHUNKS_PER_THREAD 4
+
+/* -R: tries at a name for the temporary file of each file replaced */
+#define MAX_TEMP_TRIES 100
+
+/* bytes gathered before one write(), and first size of a line reader */
+#define OUT_BUF_SIZE (256 * 1024)
+#define LINE_BUF_SIZE (64 * 1024)
+
+/* -u: unchanged lines shown around each change */
+#define DIFF_CONTEXT 3
+
+/* Diff compares mapped files in blocks growing from the first size to
+   the most */
+#define MIN_DIFF_BLOCK 256
+#define MAX_DIFF_BLOCK (1024 * 1024)
+
 #define FALSE 0
 #define TRUE  1
 
@@ -20,9 +68,54 @@ typedef enum {
   INVALID,
   FIND,
   REPLACE,
-  DIFF
+  DIFF,
+  MULTIFIND,
+  REGEX,
+  INPLACE,
+  RULES
 } CommandType;
 
+/* options given before the command */
+typedef struct {
+  int mmap;              /* -m: search a mapped stdin in place */
+  const char *patfile;   /* -p FILE: more search strings for -F */
+  int tag;               /* -t: -F prefixes lines with the string found */
+  int jobs;              /* -j N: Find searches a mapped stdin with N threads */
+  int unified;           /* -u: Diff prints the hunks of a Myers diff */
+  int flags;             /* -i, -w: STR_ICASE and STR_WORD for searches */
+  int count;             /* -c: finds print only the number of lines found */
+  int number;            /* -n: finds prefix lines with their line number */
+  int offset;            /* -b: finds prefix lines with their byte offset */
+} Options;
+
+/* output gathered in a buffer and written with write() when full */
+typedef struct {
+  int fd;
+  size_t len;
+  int error;             /* a write failed, the rest is dropped */
+  char buf[OUT_BUF_SIZE];
+} OutBuf;
+
+/* reads a file line by line into a buffer that grows to the longest
+   line, and is reused for every line */
+typedef struct {
+  int fd;
+  char *buf;
+  size_t cap;
+  size_t start, end;     /* the bytes read but not yet returned */
+  size_t scanned;        /* bytes after start known to hold no '\n' */
+  int eof, error;
+  int detect;            /* the head of the input is yet to be looked at */
+  ZReader_T oZReader;    /* decompresses the input, if it is compressed */
+} LineReader;
+
+/* lines of a mapping waiting to be written, as spans of the mapping */
+typedef struct {
+  struct iovec *iov;
+  int n, cap;
+  int flush;             /* write out when full, instead of growing */
+} SpanList;
+
 /*
  * Fill out your functions here (If you need) 
  */
@@ -36,150 +129,1458 @@ PrintUsage(const char* argv0)
 {
   const static char *fmt = 
     "Simple Grep (sgrep) Usage:\n"
-    "%s [COMMAND] [OPTIONS]...\n"
+    "%s [OPTIONS]... [COMMAND]\n"
     "\nCOMMNAD\n"
     "\tFind: -f [search-string]\n"
     "\tReplace: -r [string1] [string2]\n"
-    "\tDiff: -d [file1] [file2]\n";
+    "\tDiff: -d [file1] [file2]\n"
+    "\tMulti-find: -F [search-string]...\n"
+    "\tRegex-find: -E [regular-expression]\n"
+    "\tIn-place replace: -R [string1] [string2] [file]...\n"
+    "\tRules replace: -S [rules-file], each line of which is\n"
+    "\t    [string1]<tab>[string2]\n"
+    "\nOPTIONS\n"
+    "\t-m: Find maps stdin and prints matching lines straight from\n"
+    "\t    the mapping\n"
+    "\t-p [file]: Multi-find also searches for each line of file\n"
+    "\t-t: Multi-find prints the string found before each line,\n"
+    "\t    as [search-string]:[line]\n"
+    "\t-j [N]: Find searches a mapped stdin as with -m, split at line\n"
+    "\t    boundaries over N threads, and prints lines in input order.\n"
+    "\t    In-place replace works on N files at a time\n"
+    "\t-u: Diff finds the fewest lines to delete and insert, and\n"
+    "\t    prints them in unified diff hunks\n"
+    "\t-i: Find, Multi-find, Regex-find and the Replaces match letters\n"
+    "\t    in either case\n"
+    "\t-w: Find, Multi-find and the Replaces match only whole words, with\n"
+    "\t    no letter, digit or '_' on either side\n"
+    "\t-c: Find, Multi-find and Regex-find print only the number of\n"
+    "\t    lines found\n"
+    "\t-n: Find, Multi-find and Regex-find print the line number of\n"
+    "\t    each line found, as [number]:[line]\n"
+    "\t-b: Find, Multi-find and Regex-find print the byte offset of\n"
+    "\t    the start of each line found, as [offset]:[line]\n"
+    "\nFind, Multi-find, Regex-find and Replace decompress gzip input\n"
+    "(and zstd input, when built with it) as they read it\n";
+
+  printf(fmt, argv0);
+}
+/*-------------------------------------------------------------------*/
+/* writes all len bytes at p to fd, resuming after partial writes.
+   returns FALSE on a write error */
+static int
+WriteFd(int fd, const char *p, size_t len)
+{
+  while (len > 0) {
+    ssize_t written = write(fd, p, len);
+
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      perror("write");
+      return FALSE;
+    }
+    p += written;
+    len -= written;
+  }
+  return TRUE;
+}
+
+/* writes out what out holds */
+static int
+OutFlush(OutBuf *out)
+{
+  if (!out->error && !WriteFd(out->fd, out->buf, out->len))
+    out->error = TRUE;
+  out->len = 0;
+  return !out->error;
+}
+
+/* adds the len bytes at p to out. a run longer than the buffer is
+   written straight from p */
+static void
+OutWrite(OutBuf *out, const char *p, size_t len)
+{
+  if (out->len + len > OUT_BUF_SIZE) {
+    OutFlush(out);
+    if (len >= OUT_BUF_SIZE) {
+      if (!out->error && !WriteFd(out->fd, p, len))
+        out->error = TRUE;
+      return;
+    }
+  }
+  memcpy(out->buf + out->len, p, len);
+  out->len += len;
+}
+
+/* adds n in decimal to out, followed by the byte sep. the digits are
+   made right to left, with no call to printf */
+static void
+OutNumber(OutBuf *out, unsigned long n, char sep)
+{
+  char digits[32];
+  char *p = digits + sizeof(digits);
+
+  *--p = sep;
+  do {
+    *--p = '0' + n % 10;
+    n /= 10;
+  } while (n > 0);
+  OutWrite(out, p, digits + sizeof(digits) - p);
+}
+
+/* adds the -n and -b prefixes of a line found to out */
+static void
+OutPrefix(OutBuf *out, const Options *opts, unsigned long lineno,
+          unsigned long offset)
+{
+  if (opts->number)
+    OutNumber(out, lineno, ':');
+  if (opts->offset)
+    OutNumber(out, offset, ':');
+}
+
+/* starts r on fd, returns FALSE if out of memory */
+static int
+LineReader_init(LineReader *r, int fd)
+{
+  memset(r, 0, sizeof(*r));
+  r->fd = fd;
+  r->cap = LINE_BUF_SIZE;
+  if (!(r->buf = malloc(r->cap))) {
+    fprintf(stderr, "Error: out of memory\n");
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/* LineReader_init() for the input of a find or replace, which is
+   decompressed if it starts as a compressed file does */
+static int
+LineReader_initInput(LineReader *r, int fd)
+{
+  if (!LineReader_init(r, fd))
+    return FALSE;
+  r->detect = TRUE;
+  return TRUE;
+}
+
+static void
+LineReader_free(LineReader *r)
+{
+  ZReader_free(r->oZReader);
+  r->oZReader = NULL;
+  free(r->buf);
+  r->buf = NULL;
+}
+
+/* once the first ZREAD_HEAD bytes are read, hands all read so far to a
+   ZReader if they start a compressed input. returns FALSE, setting
+   r->error, if the ZReader cannot start */
+static int
+LineReader_detect(LineReader *r)
+{
+  const char *pcError;
+  int format;
+
+  /* the bytes read while detecting were not scanned for '\n' */
+  r->detect = FALSE;
+  r->scanned = 0;
+  if ((format = ZReader_detect(r->buf, r->end)) == ZREAD_NONE)
+    return TRUE;
+
+  r->oZReader = ZReader_new(r->fd, format, r->buf, r->end, &pcError);
+  if (!r->oZReader) {
+    fprintf(stderr, "Error: %s\n", pcError);
+    r->error = TRUE;
+    return FALSE;
+  }
+  r->start = r->end = r->scanned = 0;
+  r->eof = FALSE;
+  return TRUE;
+}
+
+/* points *ppcLine at the next line of r and stores its length with the
+   '\n', if it has one, in *plen. the line stays valid until the next
+   call. returns FALSE at the end of the input, or on an error, which
+   sets r->error */
+static int
+LineReader_next(LineReader *r, char **ppcLine, size_t *plen)
+{
+  while (TRUE) {
+    char *pcNl = r->detect ? NULL :
+      memchr(r->buf + r->start + r->scanned, '\n',
+             r->end - r->start - r->scanned);
+    ssize_t n;
+
+    if (pcNl || (r->eof && r->start < r->end)) {
+      *ppcLine = r->buf + r->start;
+      *plen = pcNl ? (size_t)(pcNl + 1 - *ppcLine) : r->end - r->start;
+      r->start += *plen;
+      r->scanned = 0;
+      return TRUE;
+    }
+    if (r->eof)
+      return FALSE;
+    r->scanned = r->end - r->start;
+
+    /* make room: move the partial line down, or grow for a long one */
+    if (r->start > 0) {
+      memmove(r->buf, r->buf + r->start, r->end - r->start);
+      r->end -= r->start;
+      r->start = 0;
+    }
+    if (r->end == r->cap) {
+      char *buf = realloc(r->buf, 2 * r->cap);
+      if (!buf) {
+        fprintf(stderr, "Error: out of memory\n");
+        r->error = TRUE;
+        return FALSE;
+      }
+      r->buf = buf;
+      r->cap *= 2;
+    }
+
+    if (r->oZReader) {
+      n = ZReader_read(r->oZReader, r->buf + r->end, r->cap - r->end);
+      if (n < 0) {
+        fprintf(stderr, "Error: %s\n", ZReader_getError(r->oZReader));
+        r->error = TRUE;
+        return FALSE;
+      }
+    }
+    else if ((n = read(r->fd, r->buf + r->end, r->cap - r->end)) < 0) {
+      if (errno == EINTR)
+        continue;
+      perror("read");
+      r->error = TRUE;
+      return FALSE;
+    }
+    if (n == 0)
+      r->eof = TRUE;
+    r->end += n;
+
+    if (r->detect && (r->end >= ZREAD_HEAD || r->eof) &&
+        !LineReader_detect(r))
+      return FALSE;
+  }
+}
+
+/* the length of the len bytes of line up to a null character. a line
+   ends there, as a string read with fgets() would */
+static size_t
+LineLength(const char *line, size_t len)
+{
+  const char *nul = memchr(line, '\0', len);
+
+  return nul ? (size_t)(nul - line) : len;
+}
+
+/* the number of '\n' in the len bytes at p */
+static unsigned long
+CountLines(const char *p, size_t len)
+{
+  const char *pcEnd = p + len;
+  unsigned long n = 0;
+
+  while ((p = memchr(p, '\n', pcEnd - p))) {
+    n++;
+    p++;
+  }
+  return n;
+}
+
+/* maps the len bytes of the regular file fd into *ppcMap, NULL when it
+   is empty. returns FALSE if fd cannot be mapped */
+static int
+MapFile(int fd, const char **ppcMap, size_t *plen)
+{
+  struct stat st;
+  void *map;
+
+  if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode))
+    return FALSE;
+  *plen = st.st_size;
+  *ppcMap = NULL;
+  if (st.st_size == 0)
+    return TRUE;
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (map == MAP_FAILED)
+    return FALSE;
+  *ppcMap = map;
+  return TRUE;
+}
+/*-------------------------------------------------------------------*/
+/* DoFind()
+   Your task:
+   1. Do argument validation 
+   - String or file argument length is no more than 1023
+   - If you encounter a command-line argument that's too long, 
+   print out "Error: argument is too long"
+   
+   2. Read the each line from standard input (stdin)
+   - If you encounter a line larger than 1023 bytes, 
+   print out "Error: input line is too long" 
+   - Error message should be printed out to standard error (stderr)
+   
+   3. Check & print out the line contains a given string (search-string)
+      
+   Tips:
+   - fgets() is an useful function to read characters from file. Note 
+   that the fget() reads until newline or the end-of-file is reached. 
+   - fprintf(sderr, ...) should be useful for printing out error
+   message to standard error
+
+   NOTE: If there is any problem, return FALSE; if not, return TRUE  */
+
+/* writes the first n buffers of iov to stdout, resuming after partial
+   writes. returns FALSE on a write error */
+static int
+WriteAll(struct iovec *iov, int n)
+{
+  while (n > 0) {
+    ssize_t written = writev(STDOUT_FILENO, iov, n);
+
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      perror("writev");
+      return FALSE;
+    }
+
+    /* skip the buffers written whole, trim the one written in part */
+    while (n > 0 && (size_t)written >= iov->iov_len) {
+      written -= iov->iov_len;
+      iov++;
+      n--;
+    }
+    if (n > 0) {
+      iov->iov_base = (char *)iov->iov_base + written;
+      iov->iov_len -= written;
+    }
+  }
+  return TRUE;
+}
+
+/* writes the spans of list in batches of MAX_IOV and empties it.
+   returns FALSE on a write error */
+static int
+WriteSpans(SpanList *list)
+{
+  int i, n;
+
+  for (i = 0; i < list->n; i += n) {
+    n = (list->n - i < MAX_IOV) ? list->n - i : MAX_IOV;
+    if (!WriteAll(list->iov + i, n))
+      return FALSE;
+  }
+  list->n = 0;
+  return TRUE;
+}
+
+/* appends the len bytes at p to list, joined to the last span when they
+   follow it. returns FALSE on a write error or if out of memory */
+static int
+AddSpan(SpanList *list, const char *p, size_t len)
+{
+  struct iovec *last = list->n ? &list->iov[list->n - 1] : NULL;
+
+  if (last && (const char *)last->iov_base + last->iov_len == p) {
+    last->iov_len += len;
+    return TRUE;
+  }
+
+  if (list->n == list->cap) {
+    if (list->flush) {
+      if (!WriteSpans(list))
+        return FALSE;
+    }
+    else {
+      int cap = list->cap ? 2 * list->cap : MAX_IOV;
+      struct iovec *iov = realloc(list->iov, cap * sizeof(*iov));
+      if (!iov) {
+        fprintf(stderr, "Error: out of memory\n");
+        return FALSE;
+      }
+      list->iov = iov;
+      list->cap = cap;
+    }
+  }
+
+  list->iov[list->n].iov_base = (void *)p;
+  list->iov[list->n].iov_len = len;
+  list->n++;
+  return TRUE;
+}
+
+/* finds the next line of the mapped bytes from p to pcEnd, which start
+   a line, that the line reader would print: the needle of oMatcher must
+   lie in the line before its first null character, and not run on into
+   the next line. returns the start of the line, or NULL, and stores the
+   end of the line, '\n' included, in *ppcNext and the length the line
+   reader gives it in *plen. lines without a match are skipped without
+   being scanned for '\n' */
+static const char *
+FindLine(StrMatcher_T oMatcher, const char *p, const char *pcEnd,
+         const char **ppcNext, size_t *plen)
+{
+  size_t m = StrMatcher_getLength(oMatcher);
+  const char *pcMatch;
+
+  while (p < pcEnd &&
+         (pcMatch = StrMatcher_search(oMatcher, p, pcEnd - p))) {
+    const char *pcStart = pcMatch;
+    const char *pcNl;
+    size_t len;
+
+    while (pcStart > p && pcStart[-1] != '\n')
+      pcStart--;
+    pcNl = memchr(pcMatch, '\n', pcEnd - pcMatch);
+    p = pcNl ? pcNl + 1 : pcEnd;
+    len = LineLength(pcStart, p - pcStart);
+
+    /* a match past the end of the line is looked for again in it */
+    if (pcMatch + m <= pcStart + len ||
+        StrMatcher_search(oMatcher, pcStart, len)) {
+      *ppcNext = p;
+      *plen = len;
+      return pcStart;
+    }
+  }
+  return NULL;
+}
+
+/* searches the len bytes of the mapped input, which start a line, for
+   the needle of oMatcher and adds every line holding it to out, or only
+   counts them in *pcount when out is NULL. the lines are those the line
+   reader would print (FindLine()) */
+static int
+FindMapped(const char *pcMap, size_t len, StrMatcher_T oMatcher,
+           SpanList *out, unsigned long *pcount)
+{
+  const char *pcEnd = pcMap + len;
+  const char *pcDone = pcMap;  /* everything before was handled */
+  const char *pcStart;
+  size_t n;
+
+  while ((pcStart = FindLine(oMatcher, pcDone, pcEnd, &pcDone, &n))) {
+    if (!out)
+      (*pcount)++;
+    else if (!AddSpan(out, pcStart, n))
+      return FALSE;
+  }
+  return TRUE;
+}
+
+/* FindMapped() for -n and -b: the lines found are copied to out after
+   their prefixes. the line number is kept up by counting the '\n' from
+   one line found to the next */
+static int
+FindMappedPrefixed(const char *pcMap, size_t len, StrMatcher_T oMatcher,
+                   const Options *opts, OutBuf *out)
+{
+  const char *pcEnd = pcMap + len;
+  const char *pcDone = pcMap;
+  const char *pcStart, *pcNext;
+  unsigned long lineno = 1;
+  size_t n;
+
+  while (!out->error &&
+         (pcStart = FindLine(oMatcher, pcDone, pcEnd, &pcNext, &n))) {
+    if (opts->number)
+      lineno += CountLines(pcDone, pcStart - pcDone);
+    pcDone = pcNext;
+
+    OutPrefix(out, opts, lineno, pcStart - pcMap);
+    OutWrite(out, pcStart, n);
+    lineno++;
+  }
+  return !out->error;
+}
+
+/* one piece of the input of a parallel find */
+typedef struct {
+  const char *pcStart;
+  size_t len;
+  SpanList out;          /* its matching lines */
+  unsigned long count;   /* or their number, for -c */
+  int done, ok;
+} FindChunk;
+
+/* state shared by the find workers and the writer */
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;   /* signaled when a chunk is done */
+  FindChunk *chunks;
+  int nchunks;
+  int next;              /* next chunk to hand out */
+  int stop;              /* set by the writer after an error */
+  int count;             /* the chunks only count their lines */
+  StrMatcher_T oMatcher;
+} FindPool;
+
+static void *
+FindWorker(void *arg)
+{
+  FindPool *pool = arg;
+
+  while (TRUE) {
+    FindChunk *chunk;
+    int i, ok;
+
+    pthread_mutex_lock(&pool->lock);
+    i = pool->stop ? pool->nchunks : pool->next++;
+    pthread_mutex_unlock(&pool->lock);
+    if (i >= pool->nchunks)
+      return NULL;
+
+    chunk = &pool->chunks[i];
+    ok = FindMapped(chunk->pcStart, chunk->len, pool->oMatcher,
+                    pool->count ? NULL : &chunk->out, &chunk->count);
+
+    pthread_mutex_lock(&pool->lock);
+    chunk->ok = ok;
+    chunk->done = TRUE;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+  }
+}
+
+/* FindMapped() with njobs threads. the input is cut into chunks that
+   end at a newline, handed out in order, and the lines each chunk found
+   are written in chunk order as soon as the chunks before it are out.
+   with pcount, the chunks only count their lines, and the sum is stored
+   in *pcount */
+static int
+FindParallel(const char *pcMap, size_t len, StrMatcher_T oMatcher,
+             int njobs, unsigned long *pcount)
+{
+  pthread_t threads[MAX_THREADS];
+  FindPool pool;
+  const char *p = pcMap, *pcEnd = pcMap + len;
+  int nchunks, nthreads, i, ret = TRUE;
+
+  nchunks = njobs * CHUNKS_PER_THREAD;
+  if ((size_t)nchunks > len / MIN_CHUNK + 1)
+    nchunks = len / MIN_CHUNK + 1;
+
+  if (!(pool.chunks = calloc(nchunks, sizeof(*pool.chunks)))) {
+    fprintf(stderr, "Error: out of memory\n");
+    return FALSE;
+  }
+  /* chunk i ends at the first newline after i + 1 shares of the input */
+  for (i = 0; i < nchunks; i++) {
+    const char *q = pcMap + len / nchunks * (i + 1);
+    const char *pcNl;
+
+    if (q < p)
+      q = p;
+    if (i == nchunks - 1)
+      q = pcEnd;
+    else if (q < pcEnd)
+      q = (pcNl = memchr(q, '\n', pcEnd - q)) ? pcNl + 1 : pcEnd;
+    pool.chunks[i].pcStart = p;
+    pool.chunks[i].len = q - p;
+    p = q;
+  }
+
+  pthread_mutex_init(&pool.lock, NULL);
+  pthread_cond_init(&pool.cond, NULL);
+  pool.nchunks = nchunks;
+  pool.next = 0;
+  pool.stop = FALSE;
+  pool.count = pcount != NULL;
+  pool.oMatcher = oMatcher;
+
+  nthreads = (njobs < nchunks) ? njobs : nchunks;
+  for (i = 0; i < nthreads; i++) {
+    /* go on with the threads there are */
+    if (pthread_create(&threads[i], NULL, FindWorker, &pool))
+      break;
+  }
+  /* with no thread at all the writer searches by itself */
+  if ((nthreads = i) == 0)
+    FindWorker(&pool);
+
+  /* the sequenced output: chunk i is written once it and all before it
+     are done */
+  for (i = 0; i < nchunks; i++) {
+    FindChunk *chunk = &pool.chunks[i];
+
+    pthread_mutex_lock(&pool.lock);
+    while (!chunk->done && !pool.stop)
+      pthread_cond_wait(&pool.cond, &pool.lock);
+    pthread_mutex_unlock(&pool.lock);
+
+    if (ret && chunk->done && chunk->ok && pcount)
+      *pcount += chunk->count;
+    else if (ret && (!chunk->done || !chunk->ok ||
+                     !WriteSpans(&chunk->out))) {
+      ret = FALSE;
+      pthread_mutex_lock(&pool.lock);
+      pool.stop = TRUE;
+      pthread_mutex_unlock(&pool.lock);
+    }
+    if (!ret)
+      break;
+  }
+
+  for (i = 0; i < nthreads; i++)
+    pthread_join(threads[i], NULL);
+  for (i = 0; i < nchunks; i++)
+    free(pool.chunks[i].out.iov);
+  free(pool.chunks);
+  pthread_cond_destroy(&pool.cond);
+  pthread_mutex_destroy(&pool.lock);
+  return ret;
+}
+
+/* maps stdin and runs FindMapped(), or FindParallel() for more than one
+   job, over it. -n and -b take FindMappedPrefixed() on one thread, and
+   -c adds the count to out. returns -1 when stdin is not a mappable
+   regular file, so the caller reads it instead */
+static int
+FindStdinMapped(StrMatcher_T oMatcher, const Options *opts, OutBuf *out)
+{
+  struct iovec iov[MAX_IOV];
+  SpanList spans;
+  struct stat st;
+  const char *pcStart;
+  size_t len;
+  unsigned long count = 0;
+  off_t off;
+  void *map;
+  int ret;
+
+  if (fstat(STDIN_FILENO, &st) < 0 || !S_ISREG(st.st_mode))
+    return -1;
+  off = lseek(STDIN_FILENO, 0, SEEK_CUR);
+  if (off < 0 || off >= st.st_size)
+    return -1;
+
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, STDIN_FILENO, 0);
+  if (map == MAP_FAILED)
+    return -1;
+
+  pcStart = (const char *)map + off;
+  len = st.st_size - off;
+  /* compressed input is left to the line reader to decompress */
+  if (ZReader_detect(pcStart, len < ZREAD_HEAD ? len : ZREAD_HEAD)) {
+    munmap(map, st.st_size);
+    return -1;
+  }
+  if (opts->count) {
+    if (opts->jobs > 1)
+      ret = FindParallel(pcStart, len, oMatcher, opts->jobs, &count);
+    else
+      ret = FindMapped(pcStart, len, oMatcher, NULL, &count);
+    if (ret)
+      OutNumber(out, count, '\n');
+  }
+  else if (opts->number || opts->offset)
+    ret = FindMappedPrefixed(pcStart, len, oMatcher, opts, out);
+  else if (opts->jobs > 1)
+    ret = FindParallel(pcStart, len, oMatcher, opts->jobs, NULL);
+  else {
+    spans.iov = iov;
+    spans.n = 0;
+    spans.cap = MAX_IOV;
+    spans.flush = TRUE;
+    ret = FindMapped(pcStart, len, oMatcher, &spans, NULL) &&
+      WriteSpans(&spans);
+  }
+  munmap(map, st.st_size);
+  return ret;
+}
+
+/*reads line by line from stdin and prints the line */
+int
+DoFind(const char *pcSearch, const Options *opts)
+{
+  static OutBuf out;
+  LineReader reader;
+  StrMatcher_T oMatcher;
+  char *line;
+  size_t len, raw;
+  unsigned long lineno = 0, offset = 0, count = 0;
+  int ret;
+
+  len = StrGetLength (pcSearch);
+
+  if (!len) {
+    fprintf(stderr,"Error: Can't replace an empty substring\n");
+    return FALSE;
+  }
+
+  if (len > MAX_STR_LEN) {
+    fprintf(stderr,"Error: argument is too long\n");
+    return FALSE;
+  }
+
+  /* compiled once, searched for on every line */
+  if (!(oMatcher = StrMatcher_newFlags(pcSearch, opts->flags))) {
+    fprintf(stderr, "Error: out of memory\n");
+    return FALSE;
+  }
+
+  /* with -w, a needle ending a line with its '\n' is followed by the
+     end of the line read, but by the next line in a mapping, so it is
+     left to the line reader */
+  out.fd = STDOUT_FILENO;
+  if ((opts->mmap || opts->jobs > 1) &&
+      !((opts->flags & STR_WORD) && strchr(pcSearch, '\n')) &&
+      (ret = FindStdinMapped(oMatcher, opts, &out)) >= 0) {
+    StrMatcher_free(oMatcher);
+    return OutFlush(&out) && ret;
+  }
+
+  if (!LineReader_initInput(&reader, STDIN_FILENO)) {
+    StrMatcher_free(oMatcher);
+    return FALSE;
+  }
+
+  /* Read the line by line from stdin */
+  while (!out.error && LineReader_next(&reader, &line, &raw)) {
+    len = LineLength(line, raw);
+    lineno++;
+    if (StrMatcher_search(oMatcher, line, len)) {
+      if (opts->count)
+        count++;
+      else {
+        OutPrefix(&out, opts, lineno, offset);
+        OutWrite(&out, line, len);
+      }
+    }
+    offset += raw;
+  }
+  if (opts->count && !reader.error)
+    OutNumber(&out, count, '\n');
+  OutFlush(&out);
+
+  LineReader_free(&reader);
+  StrMatcher_free(oMatcher);
+  return !reader.error && !out.error;
+}
+/*-------------------------------------------------------------------*/
+/* DoMultiFind()
+   Find for many search strings in one pass over stdin. The search
+   strings come from the arguments and the lines of the -p file, and
+   are found by one Aho-Corasick automaton (StrSet in str.c).        */
+/*-------------------------------------------------------------------*/
+
+/* adds each line of the file pcFile but empty ones to oSet */
+static int
+AddPatternFile(StrSet_T oSet, const char *pcFile)
+{
+  LineReader reader;
+  char *line;
+  size_t len;
+  int fd, ret = TRUE;
+
+  if (StrGetLength(pcFile) > MAX_STR_LEN) {
+    fprintf(stderr, "Error: argument is too long\n");
+    return FALSE;
+  }
+  if ((fd = open(pcFile, O_RDONLY)) < 0) {
+    fprintf(stderr, "Error: failed to open file %s\n", pcFile);
+    return FALSE;
+  }
+  if (!LineReader_init(&reader, fd)) {
+    close(fd);
+    return FALSE;
+  }
+
+  while (LineReader_next(&reader, &line, &len)) {
+    len = LineLength(line, len);
+    if (len > 0 && line[len - 1] == '\n')
+      len--;
+    if (len > 0 && StrSet_add(oSet, line, len) < 0) {
+      fprintf(stderr, "Error: out of memory\n");
+      ret = FALSE;
+      break;
+    }
+  }
+  if (reader.error)
+    ret = FALSE;
+
+  LineReader_free(&reader);
+  close(fd);
+  return ret;
+}
+
+/* reads line by line from stdin and prints the lines holding any of the
+   npats strings of ppcSearch or of the -p file */
+int
+DoMultiFind(int npats, const char *ppcSearch[], const Options *opts)
+{
+  static OutBuf out;
+  LineReader reader;
+  StrSet_T oSet;
+  char *line;
+  size_t len, raw;
+  unsigned long lineno = 0, offset = 0, count = 0;
+  int i, pat, ret = TRUE;
+
+  if (!(oSet = StrSet_newFlags(opts->flags))) {
+    fprintf(stderr, "Error: out of memory\n");
+    return FALSE;
+  }
+
+  for (i = 0; i < npats; i++) {
+    len = StrGetLength(ppcSearch[i]);
+    if (!len) {
+      fprintf(stderr,"Error: Can't replace an empty substring\n");
+      ret = FALSE;
+    }
+    else if (len > MAX_STR_LEN) {
+      fprintf(stderr,"Error: argument is too long\n");
+      ret = FALSE;
+    }
+    else if (StrSet_add(oSet, ppcSearch[i], len) < 0) {
+      fprintf(stderr, "Error: out of memory\n");
+      ret = FALSE;
+    }
+    if (!ret)
+      goto done;
+  }
+
+  if (opts->patfile && !(ret = AddPatternFile(oSet, opts->patfile)))
+    goto done;
+
+  if (StrSet_getCount(oSet) == 0) {
+    fprintf(stderr, "Error: no search string\n");
+    ret = FALSE;
+    goto done;
+  }
+  if (!StrSet_compile(oSet)) {
+    fprintf(stderr, "Error: out of memory\n");
+    ret = FALSE;
+    goto done;
+  }
+
+  if (!(ret = LineReader_initInput(&reader, STDIN_FILENO)))
+    goto done;
+  out.fd = STDOUT_FILENO;
+
+  while (!out.error && LineReader_next(&reader, &line, &raw)) {
+    len = LineLength(line, raw);
+    lineno++;
+    if (StrSet_search(oSet, line, len, &pat)) {
+      if (opts->count)
+        count++;
+      else {
+        OutPrefix(&out, opts, lineno, offset);
+        if (opts->tag) {
+          OutWrite(&out, StrSet_getPattern(oSet, pat),
+                   StrSet_getLength(oSet, pat));
+          OutWrite(&out, ":", 1);
+        }
+        OutWrite(&out, line, len);
+      }
+    }
+    offset += raw;
+  }
+  if (opts->count && !reader.error)
+    OutNumber(&out, count, '\n');
+  OutFlush(&out);
+  LineReader_free(&reader);
+  ret = !reader.error && !out.error;
+
+ done:
+  StrSet_free(oSet);
+  return ret;
+}
+/*-------------------------------------------------------------------*/
+/* DoRegexFind()
+   Find for a regular expression (see regexp.h). ^ and $ match at the
+   start and the end of each line, not counting its '\n'.            */
+/*-------------------------------------------------------------------*/
+int
+DoRegexFind(const char *pcPattern, const Options *opts)
+{
+  static OutBuf out;
+  LineReader reader;
+  Regexp_T oRegexp;
+  const char *pcError;
+  char *line;
+  size_t len, raw, text;
+  unsigned long lineno = 0, offset = 0, count = 0;
+  int found = 0;
+
+  if (StrGetLength(pcPattern) > MAX_STR_LEN) {
+    fprintf(stderr, "Error: argument is too long\n");
+    return FALSE;
+  }
+
+  /* the DFA is built as lines need it, and kept for all of them */
+  oRegexp = Regexp_new(pcPattern, (opts->flags & STR_ICASE) ? REGEXP_ICASE : 0,
+                       &pcError);
+  if (!oRegexp) {
+    fprintf(stderr, "Error: invalid regular expression: %s\n", pcError);
+    return FALSE;
+  }
+  if (!LineReader_initInput(&reader, STDIN_FILENO)) {
+    Regexp_free(oRegexp);
+    return FALSE;
+  }
+  out.fd = STDOUT_FILENO;
+
+  while (!out.error && LineReader_next(&reader, &line, &raw)) {
+    len = LineLength(line, raw);
+    lineno++;
+    text = (len > 0 && line[len - 1] == '\n') ? len - 1 : len;
+    if ((found = Regexp_match(oRegexp, line, text)) < 0) {
+      fprintf(stderr, "Error: out of memory\n");
+      break;
+    }
+    if (found && opts->count)
+      count++;
+    else if (found) {
+      OutPrefix(&out, opts, lineno, offset);
+      OutWrite(&out, line, len);
+    }
+    offset += raw;
+  }
+  if (opts->count && found >= 0 && !reader.error)
+    OutNumber(&out, count, '\n');
+  OutFlush(&out);
+
+  LineReader_free(&reader);
+  Regexp_free(oRegexp);
+  return found >= 0 && !reader.error && !out.error;
+}
+/*-------------------------------------------------------------------*/
+/* DoReplace()
+   Your task:
+   1. Do argument validation 
+      - String length is no more than 1023
+      - If you encounter a command-line argument that's too long, 
+        print out "Error: argument is too long"
+      - If word1 is an empty string,
+        print out "Error: Can't replace an empty substring"
+      
+   2. Read the each line from standard input (stdin)
+      - If you encounter a line larger than 1023 bytes, 
+        print out "Error: input line is too long" 
+      - Error message should be printed out to standard error (stderr)
+
+   3. Replace the string and print out the replaced string
+
+   NOTE: If there is any problem, return FALSE; if not, return TRUE  */
+/*-------------------------------------------------------------------*/
+
+
+/* writes the replaced form of the len bytes of orig to out, where every
+   match of oMatcher is replaced to str2 of len2 bytes. the matcher jumps
+   from one match to the next, and the text in between is copied as one
+   span. returns the number of matches replaced */
+static unsigned long
+print_replaced_str (OutBuf *out, const char *orig, size_t len,
+                    StrMatcher_T oMatcher, const char *str2, size_t len2) {
+  size_t len1 = StrMatcher_getLength (oMatcher);
+  const char *line = orig, *end = orig + len;
+  const char *match;
+  unsigned long n = 0;
+
+  /* searched in the whole line, so -w sees the bytes before orig */
+  while ((match = StrMatcher_searchAt (oMatcher, line, len, orig - line))) {
+    OutWrite (out, orig, match - orig);
+    OutWrite (out, str2, len2);
+    orig = match + len1;
+    n++;
+  }
+  OutWrite (out, orig, end - orig);
+  return n;
+}
+
+/* reads line by line and prints the replaed form of that line. lines
+   may be of any length */
+int
+DoReplace(const char *pcString1, const char *pcString2, const Options *opts)
+{
+  static OutBuf out;
+  LineReader reader;
+  StrMatcher_T oMatcher;
+  unsigned long len1, len2;
+  char *line;
+  size_t len;
+
+  len1 = StrGetLength (pcString1);
+  len2 = StrGetLength (pcString2);
+
+  /* check if pcString1 is not empty */
+  if (!len1) {
+    fprintf(stderr,"Error: Can't replace an empty substring\n");
+    return FALSE;
+  }
+
+  /* check length of arg1 and arg2 */
+
+  if (len1 > MAX_STR_LEN || len2 > MAX_STR_LEN) {
+    fprintf(stderr,"Error: argument is too long\n");
+    return FALSE;
+  }
+
+  /* compiled once, searched for on every line */
+  if (!(oMatcher = StrMatcher_newFlags(pcString1, opts->flags))) {
+    fprintf(stderr, "Error: out of memory\n");
+    return FALSE;
+  }
+  if (!LineReader_initInput(&reader, STDIN_FILENO)) {
+    StrMatcher_free(oMatcher);
+    return FALSE;
+  }
+  out.fd = STDOUT_FILENO;
+
+  while (!out.error && LineReader_next(&reader, &line, &len)) {
+    print_replaced_str (&out, line, LineLength(line, len), oMatcher,
+                        pcString2, len2);
+  }
+  OutFlush(&out);
+
+  LineReader_free(&reader);
+  StrMatcher_free(oMatcher);
+  return !reader.error && !out.error;
+}
+/*-------------------------------------------------------------------*/
+/* DoReplaceRules()
+   Replace for every rule of a rules file in one pass. The strings to
+   replace go into one StrSet, and at each point of a line the
+   leftmost-longest of them is replaced by its rule's string2.       */
+/*-------------------------------------------------------------------*/
+
+/* the string2 of each rule, by the index of its string1 in the set */
+typedef struct {
+  char **ppcTo;
+  size_t *lens;
+  int n, cap;
+} RuleList;
+
+static void
+RuleList_free(RuleList *rules)
+{
+  int i;
+
+  for (i = 0; i < rules->n; i++)
+    free(rules->ppcTo[i]);
+  free(rules->ppcTo);
+  free(rules->lens);
+}
+
+/* adds the rule of line number lineno, string1 and string2 split by a
+   tab, to oSet and rules. a string1 seen before keeps its first rule */
+static int
+AddRule(StrSet_T oSet, RuleList *rules, const char *line, size_t len,
+        const char *pcFile, unsigned long lineno)
+{
+  const char *pcTab = memchr(line, '\t', len);
+  size_t len1, len2;
+  int i;
+
+  if (!pcTab) {
+    fprintf(stderr, "Error: no tab in rule %s@%lu\n", pcFile, lineno);
+    return FALSE;
+  }
+  if ((len1 = pcTab - line) == 0) {
+    fprintf(stderr,"Error: Can't replace an empty substring\n");
+    return FALSE;
+  }
+  len2 = len - len1 - 1;
+
+  if ((i = StrSet_add(oSet, line, len1)) < 0)
+    goto nomem;
+  if (i < rules->n)
+    return TRUE;
+
+  if (rules->n == rules->cap) {
+    int cap = rules->cap ? 2 * rules->cap : 16;
+    char **ppcTo = realloc(rules->ppcTo, cap * sizeof(*ppcTo));
+    size_t *lens;
+
+    if (!ppcTo)
+      goto nomem;
+    rules->ppcTo = ppcTo;
+    if (!(lens = realloc(rules->lens, cap * sizeof(*lens))))
+      goto nomem;
+    rules->lens = lens;
+    rules->cap = cap;
+  }
+  if (!(rules->ppcTo[rules->n] = malloc(len2 + 1)))
+    goto nomem;
+  memcpy(rules->ppcTo[rules->n], pcTab + 1, len2);
+  rules->lens[rules->n] = len2;
+  rules->n++;
+  return TRUE;
+
+ nomem:
+  fprintf(stderr, "Error: out of memory\n");
+  return FALSE;
+}
+
+/* reads the rules of the file pcFile, skipping empty lines */
+static int
+AddRuleFile(StrSet_T oSet, RuleList *rules, const char *pcFile)
+{
+  LineReader reader;
+  char *line;
+  size_t len;
+  unsigned long lineno = 0;
+  int fd, ret = TRUE;
+
+  if (StrGetLength(pcFile) > MAX_STR_LEN) {
+    fprintf(stderr, "Error: argument is too long\n");
+    return FALSE;
+  }
+  if ((fd = open(pcFile, O_RDONLY)) < 0) {
+    fprintf(stderr, "Error: failed to open file %s\n", pcFile);
+    return FALSE;
+  }
+  if (!LineReader_init(&reader, fd)) {
+    close(fd);
+    return FALSE;
+  }
+
+  while (LineReader_next(&reader, &line, &len)) {
+    lineno++;
+    len = LineLength(line, len);
+    if (len > 0 && line[len - 1] == '\n')
+      len--;
+    if (len > 0 && !AddRule(oSet, rules, line, len, pcFile, lineno)) {
+      ret = FALSE;
+      break;
+    }
+  }
+  if (reader.error)
+    ret = FALSE;
+
+  LineReader_free(&reader);
+  close(fd);
+  return ret;
+}
+
+/* writes the len bytes of orig to out with every match of oSet replaced
+   by the string2 of its rule */
+static void
+print_replaced_rules (OutBuf *out, const char *orig, size_t len,
+                      StrSet_T oSet, const RuleList *rules) {
+  const char *line = orig, *end = orig + len;
+  const char *match;
+  int pat;
+
+  while ((match = StrSet_searchAt (oSet, line, len, orig - line, &pat))) {
+    OutWrite (out, orig, match - orig);
+    OutWrite (out, rules->ppcTo[pat], rules->lens[pat]);
+    orig = match + StrSet_getLength (oSet, pat);
+  }
+  OutWrite (out, orig, end - orig);
+}
+
+/* reads line by line and prints each line with the rules of the file
+   pcRulesFile applied */
+int
+DoReplaceRules(const char *pcRulesFile, const Options *opts)
+{
+  static OutBuf out;
+  LineReader reader;
+  RuleList rules;
+  StrSet_T oSet;
+  char *line;
+  size_t len;
+  int ret;
 
-  printf(fmt, argv0);
+  memset(&rules, 0, sizeof(rules));
+  if (!(oSet = StrSet_newFlags(opts->flags))) {
+    fprintf(stderr, "Error: out of memory\n");
+    return FALSE;
+  }
+  if (!(ret = AddRuleFile(oSet, &rules, pcRulesFile)))
+    goto done;
+  if (rules.n == 0) {
+    fprintf(stderr, "Error: no rule in %s\n", pcRulesFile);
+    ret = FALSE;
+    goto done;
+  }
+  if (!StrSet_compile(oSet)) {
+    fprintf(stderr, "Error: out of memory\n");
+    ret = FALSE;
+    goto done;
+  }
+
+  if (!(ret = LineReader_initInput(&reader, STDIN_FILENO)))
+    goto done;
+  out.fd = STDOUT_FILENO;
+
+  while (!out.error && LineReader_next(&reader, &line, &len))
+    print_replaced_rules(&out, line, LineLength(line, len), oSet, &rules);
+  OutFlush(&out);
+  LineReader_free(&reader);
+  ret = !reader.error && !out.error;
+
+ done:
+  RuleList_free(&rules);
+  StrSet_free(oSet);
+  return ret;
 }
 /*-------------------------------------------------------------------*/
-/* DoFind()
-   Your task:
-   1. Do argument validation 
-   - String or file argument length is no more than 1023
-   - If you encounter a command-line argument that's too long, 
-   print out "Error: argument is too long"
-   
-   2. Read the each line from standard input (stdin)
-   - If you encounter a line larger than 1023 bytes, 
-   print out "Error: input line is too long" 
-   - Error message should be printed out to standard error (stderr)
-   
-   3. Check & print out the line contains a given string (search-string)
-      
-   Tips:
-   - fgets() is an useful function to read characters from file. Note 
-   that the fget() reads until newline or the end-of-file is reached. 
-   - fprintf(sderr, ...) should be useful for printing out error
-   message to standard error
+/* DoReplaceFiles()
+   Replace in each of a list of files, in place. A file is written to
+   a new file in its directory, synced and renamed over it, so it is
+   never seen half written. A symbolic link is followed, and the file
+   it names is the one replaced. A file with no match is not
+   rewritten.
+   The files are shared out over the -j threads.                     */
+/*-------------------------------------------------------------------*/
 
-   NOTE: If there is any problem, return FALSE; if not, return TRUE  */
+/* state shared by the in-place replace workers */
+typedef struct {
+  pthread_mutex_t lock;
+  const char **ppcFiles;
+  int nfiles;
+  int next;              /* next file to hand out */
+  int failed;            /* a file could not be replaced */
+  StrMatcher_T oMatcher;
+  const char *pcString2;
+  size_t len2;
+} ReplacePool;
 
-/*reads line by line from stdin and prints the line */
-int
-DoFind(const char *pcSearch)
+/* creates a file of a new name next to pcFile, stores the name in
+   pcTemp and returns its fd, or -1 */
+static int
+CreateTemp(const char *pcFile, char *pcTemp)
 {
-  char buf[MAX_STR_LEN + 2]; 
-  int len;
+  int i, fd = -1;
 
-  len = StrGetLength (pcSearch);
+  for (i = 0; i < MAX_TEMP_TRIES; i++) {
+    sprintf(pcTemp, "%s.sgrep%lu.%d", pcFile, (unsigned long)getpid(), i);
+    fd = open(pcTemp, O_WRONLY | O_CREAT | O_EXCL, 0600);
+    if (fd >= 0 || errno != EEXIST)
+      break;
+  }
+  return fd;
+}
 
-  if (!len) {
-    fprintf(stderr,"Error: Can't replace an empty substring\n");
+/* syncs the directory holding the file pcPath, so a rename in it is
+   on disk. pcPath holds a '/', as a path from realpath() does */
+static int
+SyncDir(const char *pcPath)
+{
+  char *pcDir;
+  size_t len;
+  int fd, ok;
+
+  len = strrchr(pcPath, '/') - pcPath;
+  if (!(pcDir = malloc(len + 2)))
     return FALSE;
-  }
+  memcpy(pcDir, pcPath, len);
+  if (len == 0)
+    pcDir[len++] = '/';
+  pcDir[len] = '\0';
+  fd = open(pcDir, O_RDONLY);
+  free(pcDir);
+  if (fd < 0)
+    return FALSE;
+  ok = fsync(fd) == 0;
+  close(fd);
+  return ok;
+}
 
-  if (len > MAX_STR_LEN) {
-    fprintf(stderr,"Error: argument is too long\n");
+/* replaces in the file pcFile in place, writing through out. the lines
+   up to a match are copied from the mapping as they are, and only the
+   lines holding one are replaced. returns FALSE, having said why, if
+   the file could not be replaced */
+static int
+ReplaceFile(ReplacePool *pool, const char *pcFile, OutBuf *out)
+{
+  struct stat st;
+  const char *pcMap, *pcEnd, *pcMatch, *line, *pcStart, *pcNl;
+  char *pcPath, *pcTemp;
+  size_t len;
+  unsigned long nrep = 0;  /* matches replaced */
+  int fd, ok;
+
+  if (StrGetLength(pcFile) > MAX_STR_LEN) {
+    fprintf(stderr, "Error: argument is too long\n");
+    return FALSE;
+  }
+  /* the new file is made next to the file a link names, and renamed
+     over that file, so the link is kept */
+  if (!(pcPath = realpath(pcFile, NULL)) ||
+      (fd = open(pcPath, O_RDONLY)) < 0) {
+    fprintf(stderr, "Error: failed to open file %s\n", pcFile);
+    free(pcPath);
+    return FALSE;
+  }
+  ok = fstat(fd, &st) == 0 && MapFile(fd, &pcMap, &len);
+  close(fd);
+  if (!ok) {
+    fprintf(stderr, "Error: %s is not a regular file\n", pcFile);
+    free(pcPath);
     return FALSE;
   }
 
-  /* Read the line by line from stdin, Note that this is an example */
-  while (fgets(buf, sizeof(buf), stdin)) {
-    /* check input line length */
-    if ((len = StrGetLength(buf)) > MAX_STR_LEN) {
-      fprintf(stderr, "Error: input line is too long\n");
-      return FALSE;
-    }
-    
-    if (StrSearch (buf, pcSearch)){
-      printf("%s",buf);
-    }
+  /* a file with no match is left as it is */
+  if (!pcMap || !StrMatcher_search(pool->oMatcher, pcMap, len)) {
+    if (pcMap)
+      munmap((void *)pcMap, len);
+    free(pcPath);
+    return TRUE;
   }
 
-  return TRUE;
-}
-/*-------------------------------------------------------------------*/
-/* DoReplace()
-   Your task:
-   1. Do argument validation 
-      - String length is no more than 1023
-      - If you encounter a command-line argument that's too long, 
-        print out "Error: argument is too long"
-      - If word1 is an empty string,
-        print out "Error: Can't replace an empty substring"
-      
-   2. Read the each line from standard input (stdin)
-      - If you encounter a line larger than 1023 bytes, 
-        print out "Error: input line is too long" 
-      - Error message should be printed out to standard error (stderr)
+  if (!(pcTemp = malloc(StrGetLength(pcPath) + 32))) {
+    fprintf(stderr, "Error: out of memory\n");
+    munmap((void *)pcMap, len);
+    free(pcPath);
+    return FALSE;
+  }
+  if ((out->fd = CreateTemp(pcPath, pcTemp)) < 0) {
+    fprintf(stderr, "Error: failed to create a file next to %s\n", pcFile);
+    munmap((void *)pcMap, len);
+    free(pcTemp);
+    free(pcPath);
+    return FALSE;
+  }
+  out->len = 0;
+  out->error = FALSE;
 
-   3. Replace the string and print out the replaced string
+  pcEnd = pcMap + len;
+  line = pcMap;
+  while (line < pcEnd &&
+         (pcMatch = StrMatcher_search(pool->oMatcher, line, pcEnd - line))) {
+    pcStart = pcMatch;
+    while (pcStart > line && pcStart[-1] != '\n')
+      pcStart--;
+    OutWrite(out, line, pcStart - line);
+    pcNl = memchr(pcMatch, '\n', pcEnd - pcMatch);
+    line = pcNl ? pcNl + 1 : pcEnd;
+    nrep += print_replaced_str(out, pcStart, line - pcStart,
+                               pool->oMatcher, pool->pcString2, pool->len2);
+  }
+  OutWrite(out, line, pcEnd - line);
 
-   NOTE: If there is any problem, return FALSE; if not, return TRUE  */
-/*-------------------------------------------------------------------*/
+  /* a match found in the whole file may not lie in one line, as one
+     holding a '\n' but not at its end. with nothing replaced, the file
+     is left as it is, and keeps its inode and its links */
+  if (nrep == 0) {
+    close(out->fd);
+    unlink(pcTemp);
+    munmap((void *)pcMap, len);
+    free(pcTemp);
+    free(pcPath);
+    return TRUE;
+  }
+
+  /* the new file takes the owner, group and mode of the old one, as
+     far as we may give them, and is on disk before it takes its name.
+     the owner is set first, as that clears the set-id bits. one who is
+     not root may not give a file away, and then only the group is kept
+     if it may be */
+  ok = OutFlush(out);
+  if (ok && fchown(out->fd, st.st_uid, st.st_gid) < 0 &&
+      (errno != EPERM ||
+       (fchown(out->fd, (uid_t)-1, st.st_gid) < 0 && errno != EPERM)))
+    ok = FALSE;
+  ok = ok && fchmod(out->fd, st.st_mode & 07777) == 0 &&
+    fsync(out->fd) == 0;
+  if (close(out->fd) < 0)
+    ok = FALSE;
+  /* and the rename is on disk once the directory is */
+  if (ok && (rename(pcTemp, pcPath) < 0 || !SyncDir(pcPath)))
+    ok = FALSE;
+  if (!ok) {
+    fprintf(stderr, "Error: failed to replace in %s\n", pcFile);
+    unlink(pcTemp);
+  }
 
+  munmap((void *)pcMap, len);
+  free(pcTemp);
+  free(pcPath);
+  return ok;
+}
 
-/* prints the replaced form of orig, where all str1 is replaced to str2 */
-void 
-print_replaced_str (char *orig, const char *str1, const char *str2) {
-  unsigned long i,len1,len2;
+static void *
+ReplaceWorker(void *arg)
+{
+  ReplacePool *pool = arg;
+  OutBuf *out = malloc(sizeof(*out));
+  int i;
 
-  len1 = StrGetLength (orig);
-  len2 = StrGetLength (str1);
+  if (!out) {
+    fprintf(stderr, "Error: out of memory\n");
+    pthread_mutex_lock(&pool->lock);
+    pool->failed = TRUE;
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+  }
 
-  i = 0;
-  
-  while (i < len1) {
-    if (StrSearch (&orig[i], str1) == &orig[i]) {
-      printf("%s",str2);
-      i += len2;
-    }
+  while (TRUE) {
+    pthread_mutex_lock(&pool->lock);
+    i = pool->next++;
+    pthread_mutex_unlock(&pool->lock);
+    if (i >= pool->nfiles)
+      break;
 
-    else {
-      printf("%c",orig[i]);
-      i++;
+    if (!ReplaceFile(pool, pool->ppcFiles[i], out)) {
+      pthread_mutex_lock(&pool->lock);
+      pool->failed = TRUE;
+      pthread_mutex_unlock(&pool->lock);
     }
   }
+  free(out);
+  return NULL;
 }
 
-/* reads line by line and prints the replaed form of that line */
+/* replaces pcString1 with pcString2 in each of the nfiles files of
+   ppcFiles, on -j threads or as many as there are processors */
 int
-DoReplace(const char *pcString1, const char *pcString2)
+DoReplaceFiles(const char *pcString1, const char *pcString2, int nfiles,
+               const char *ppcFiles[], const Options *opts)
 {
+  pthread_t threads[MAX_THREADS];
+  ReplacePool pool;
+  size_t len1, len2;
+  long nthreads;
+  int i;
 
-  char buf[MAX_STR_LEN + 2]; 
-  unsigned long len1, len2, len;
-
-  len1 = StrGetLength (pcString1);
-  len2 = StrGetLength (pcString2);
-
-  /* check if pcString1 is not empty */
+  len1 = StrGetLength(pcString1);
+  len2 = StrGetLength(pcString2);
   if (!len1) {
     fprintf(stderr,"Error: Can't replace an empty substring\n");
     return FALSE;
   }
-
-  /* check length of arg1 and arg2 */
-
   if (len1 > MAX_STR_LEN || len2 > MAX_STR_LEN) {
     fprintf(stderr,"Error: argument is too long\n");
     return FALSE;
   }
 
-  while (fgets(buf, sizeof(buf), stdin)) {
-    /* check input line length */
-    if ((len = StrGetLength(buf)) > MAX_STR_LEN) {
-      fprintf(stderr, "Error: input line is too long\n");
-      return FALSE;
-    }
-    print_replaced_str (buf, pcString1, pcString2);
+  if (!(pool.oMatcher = StrMatcher_newFlags(pcString1, opts->flags))) {
+    fprintf(stderr, "Error: out of memory\n");
+    return FALSE;
   }
+  pthread_mutex_init(&pool.lock, NULL);
+  pool.ppcFiles = ppcFiles;
+  pool.nfiles = nfiles;
+  pool.next = 0;
+  pool.failed = FALSE;
+  pool.pcString2 = pcString2;
+  pool.len2 = len2;
 
+  nthreads = opts->jobs ? opts->jobs : sysconf(_SC_NPROCESSORS_ONLN);
+  if (nthreads > MAX_THREADS)
+    nthreads = MAX_THREADS;
+  if (nthreads > nfiles)
+    nthreads = nfiles;
+  for (i = 0; i < nthreads; i++) {
+    if (pthread_create(&threads[i], NULL, ReplaceWorker, &pool))
+      break;
+  }
+  if ((nthreads = i) == 0)
+    ReplaceWorker(&pool);
+  for (i = 0; i < nthreads; i++)
+    pthread_join(threads[i], NULL);
 
-  return TRUE;
+  pthread_mutex_destroy(&pool.lock);
+  StrMatcher_free(pool.oMatcher);
+  return !pool.failed;
 }
 /*-------------------------------------------------------------------*/
 /* DoDiff()
@@ -212,14 +1613,439 @@ DoReplace(const char *pcString1, const char *pcString2)
 
    NOTE: If there is any problem, return FALSE; if not, return TRUE  */
 
+/* a line of a file read whole for a unified diff, with its '\n' */
+typedef struct {
+  const char *p;
+  size_t len;
+  unsigned long hash;
+} DiffLine;
+
+/* reads all of the file pcFile into *ppcBuf, and stores its length in
+   *plen. returns FALSE if the file cannot be read */
+static int
+ReadFile(const char *pcFile, char **ppcBuf, size_t *plen)
+{
+  size_t cap = LINE_BUF_SIZE, len = 0;
+  char *buf = NULL;
+  int fd;
+
+  if ((fd = open(pcFile, O_RDONLY)) < 0) {
+    fprintf(stderr, "Error: failed to open file %s\n", pcFile);
+    return FALSE;
+  }
+
+  while (TRUE) {
+    ssize_t n;
+
+    if (!buf || len == cap) {
+      char *grown = realloc(buf, buf ? 2 * cap : cap);
+      if (!grown) {
+        fprintf(stderr, "Error: out of memory\n");
+        break;
+      }
+      if (buf)
+        cap *= 2;
+      buf = grown;
+    }
+    if ((n = read(fd, buf + len, cap - len)) < 0) {
+      if (errno == EINTR)
+        continue;
+      perror("read");
+      break;
+    }
+    if (n == 0) {
+      close(fd);
+      *ppcBuf = buf;
+      *plen = len;
+      return TRUE;
+    }
+    len += n;
+  }
+
+  free(buf);
+  close(fd);
+  return FALSE;
+}
+
+/* splits the len bytes at buf into lines and hashes each of them.
+   returns the number of lines, or -1 if out of memory */
+static long
+SplitLines(const char *buf, size_t len, DiffLine **ppLines)
+{
+  const char *p = buf, *pcEnd = buf + len;
+  size_t n = 0, cap = 1024;
+  DiffLine *lines = malloc(cap * sizeof(*lines));
+
+  while (lines && p < pcEnd) {
+    const char *pcNl = memchr(p, '\n', pcEnd - p);
+    const char *q = pcNl ? pcNl + 1 : pcEnd;
+    unsigned long hash = 2166136261UL;
+    const char *r;
+
+    if (n == cap) {
+      DiffLine *grown = realloc(lines, 2 * cap * sizeof(*lines));
+      if (!grown) {
+        free(lines);
+        lines = NULL;
+        break;
+      }
+      lines = grown;
+      cap *= 2;
+    }
+
+    /* FNV-1a */
+    for (r = p; r < q; r++)
+      hash = (hash ^ (unsigned char)*r) * 16777619UL;
+
+    lines[n].p = p;
+    lines[n].len = q - p;
+    lines[n].hash = hash;
+    n++;
+    p = q;
+  }
+
+  if (!lines) {
+    fprintf(stderr, "Error: out of memory\n");
+    return -1;
+  }
+  *ppLines = lines;
+  return (long)n;
+}
+
+/* numbers the lines of both files, equal lines alike, into ida and idb
+   through an open addressing table of the first line of each number.
+   returns FALSE if out of memory */
+static int
+NumberLines(const DiffLine *a, size_t n, const DiffLine *b, size_t m,
+            unsigned *ida, unsigned *idb)
+{
+  size_t size = 16, mask, i;
+  unsigned *table;            /* line number + 1 in a ++ b, 0 if free */
+  unsigned next = 0;
+
+  while (size < 2 * (n + m))
+    size *= 2;
+  mask = size - 1;
+  if (!(table = calloc(size, sizeof(*table)))) {
+    fprintf(stderr, "Error: out of memory\n");
+    return FALSE;
+  }
+
+  for (i = 0; i < n + m; i++) {
+    const DiffLine *line = (i < n) ? &a[i] : &b[i - n];
+    unsigned *id = (i < n) ? &ida[i] : &idb[i - n];
+    size_t h = line->hash & mask;
+
+    while (TRUE) {
+      size_t k = table[h] - 1;
+      const DiffLine *seen;
+
+      if (!table[h]) {
+        /* a new line takes the number after the last one */
+        table[h] = i + 1;
+        *id = next++;
+        break;
+      }
+      seen = (k < n) ? &a[k] : &b[k - n];
+      if (seen->hash == line->hash && seen->len == line->len &&
+          !memcmp(seen->p, line->p, line->len)) {
+        *id = (k < n) ? ida[k] : idb[k - n];
+        break;
+      }
+      h = (h + 1) & mask;
+    }
+  }
+
+  free(table);
+  return TRUE;
+}
+
+/* writes the count lines from lines with prefix c before each, marking
+   a last line with no '\n' as diff does */
+static void
+PrintDiffLines(OutBuf *out, char c, const DiffLine *lines, size_t count)
+{
+  static const char no_newline[] = "\n\\ No newline at end of file\n";
+  size_t i;
+
+  for (i = 0; i < count; i++) {
+    OutWrite(out, &c, 1);
+    OutWrite(out, lines[i].p, lines[i].len);
+    if (!lines[i].len || lines[i].p[lines[i].len - 1] != '\n')
+      OutWrite(out, no_newline, sizeof(no_newline) - 1);
+  }
+}
+
+/* writes "@@ -start,len +start,len @@" for a hunk of a[as, ae) and
+   b[bs, be), starting counts at 1 as diff does */
+static void
+PrintHunkHeader(OutBuf *out, size_t as, size_t ae, size_t bs, size_t be)
+{
+  char buf[128];
+  int n;
+
+  n = sprintf(buf, "@@ -%lu,%lu +%lu,%lu @@\n",
+              (unsigned long)(ae > as ? as + 1 : as), (unsigned long)(ae - as),
+              (unsigned long)(be > bs ? bs + 1 : bs), (unsigned long)(be - bs));
+  OutWrite(out, buf, n);
+}
+
+/* prints the hunks of the lines marked in del and ins, each change with
+   up to DIFF_CONTEXT unchanged lines around it. changes closer than
+   twice that share a hunk */
+static void
+PrintHunks(OutBuf *out, const DiffLine *a, size_t n, const char *del,
+           const DiffLine *b, size_t m, const char *ins)
+{
+  size_t i = 0, j = 0;
+
+  while (TRUE) {
+    size_t hi, hj, as, bs, ae, be, look_i, look_j;
+
+    /* skip to the next change */
+    while (i < n && j < m && !del[i] && !ins[j]) {
+      i++;
+      j++;
+    }
+    if (i == n && j == m)
+      return;
+
+    /* find how far the hunk goes: past each change, and while the next
+       one is within 2 * DIFF_CONTEXT unchanged lines */
+    hi = i;
+    hj = j;
+    look_i = i;
+    look_j = j;
+    while (TRUE) {
+      size_t k = 0;
+
+      while (look_i < n && del[look_i])
+        look_i++;
+      while (look_j < m && ins[look_j])
+        look_j++;
+      while (look_i + k < n && look_j + k < m && !del[look_i + k] &&
+             !ins[look_j + k] && k <= 2 * DIFF_CONTEXT)
+        k++;
+      if (k > 2 * DIFF_CONTEXT || (look_i + k == n && look_j + k == m))
+        break;
+      look_i += k;
+      look_j += k;
+    }
+
+    as = (hi > DIFF_CONTEXT) ? hi - DIFF_CONTEXT : 0;
+    bs = hj - (hi - as);
+    ae = (look_i + DIFF_CONTEXT < n) ? look_i + DIFF_CONTEXT : n;
+    be = look_j + (ae - look_i);
+    PrintHunkHeader(out, as, ae, bs, be);
+
+    /* context before, then changes and the unchanged lines between */
+    PrintDiffLines(out, ' ', a + as, hi - as);
+    i = hi;
+    j = hj;
+    while (i < look_i || j < look_j) {
+      size_t di = i, dj = j;
+
+      while (di < n && del[di])
+        di++;
+      while (dj < m && ins[dj])
+        dj++;
+      PrintDiffLines(out, '-', a + i, di - i);
+      PrintDiffLines(out, '+', b + j, dj - j);
+      i = di;
+      j = dj;
+      while (i < look_i && !del[i] && !ins[j]) {
+        PrintDiffLines(out, ' ', a + i, 1);
+        i++;
+        j++;
+      }
+    }
+    PrintDiffLines(out, ' ', a + i, ae - i);
+    i = ae;
+    j = be;
+  }
+}
+
+/* the -u form of DoDiff(). both files are read whole, lines are numbered
+   by content, and Diff_mark() finds the fewest lines to delete and
+   insert. prints nothing when the files are the same */
+static int
+DoUnifiedDiff(const char *file1, const char *file2)
+{
+  static OutBuf out;
+  char *buf1 = NULL, *buf2 = NULL, *del = NULL, *ins = NULL;
+  DiffLine *a = NULL, *b = NULL;
+  unsigned *ida = NULL, *idb = NULL;
+  size_t len1, len2;
+  long n, m, i, j;
+  int ret = FALSE;
+
+  if (!ReadFile(file1, &buf1, &len1) || !ReadFile(file2, &buf2, &len2))
+    goto done;
+  if ((n = SplitLines(buf1, len1, &a)) < 0 ||
+      (m = SplitLines(buf2, len2, &b)) < 0)
+    goto done;
+
+  /* one extra byte each, so that empty files still get a block */
+  ida = malloc((n + 1) * sizeof(*ida));
+  idb = malloc((m + 1) * sizeof(*idb));
+  del = malloc(n + 1);
+  ins = malloc(m + 1);
+  if (!ida || !idb || !del || !ins) {
+    fprintf(stderr, "Error: out of memory\n");
+    goto done;
+  }
+  if (!NumberLines(a, n, b, m, ida, idb))
+    goto done;
+  if (!Diff_mark(ida, n, idb, m, del, ins)) {
+    fprintf(stderr, "Error: out of memory\n");
+    goto done;
+  }
+
+  /* the same files print nothing, not even the file names */
+  for (i = 0; i < n && !del[i]; i++)
+    ;
+  for (j = 0; j < m && !ins[j]; j++)
+    ;
+  out.fd = STDOUT_FILENO;
+  if (i < n || j < m) {
+    OutWrite(&out, "--- ", 4);
+    OutWrite(&out, file1, StrGetLength(file1));
+    OutWrite(&out, "\n+++ ", 6);
+    OutWrite(&out, file2, StrGetLength(file2));
+    OutWrite(&out, "\n", 1);
+    PrintHunks(&out, a, n, del, b, m, ins);
+  }
+  ret = OutFlush(&out);
+
+ done:
+  free(buf1);
+  free(buf2);
+  free(a);
+  free(b);
+  free(ida);
+  free(idb);
+  free(del);
+  free(ins);
+  return ret;
+}
+
+/* the number of bytes at which p1 and p2 start to differ, at most len.
+   whole blocks are compared with memcmp(), growing while they match, and
+   a differing block is halved down to its first differing byte */
+static size_t
+CommonPrefix(const char *p1, const char *p2, size_t len)
+{
+  size_t done = 0, block = MIN_DIFF_BLOCK;
+
+  while (done < len) {
+    size_t n = (len - done < block) ? len - done : block;
+
+    if (memcmp(p1 + done, p2 + done, n)) {
+      while (n > 1) {
+        size_t half = n / 2;
+        if (memcmp(p1 + done, p2 + done, half) == 0) {
+          done += half;
+          n -= half;
+        }
+        else {
+          n = half;
+        }
+      }
+      return done;
+    }
+    done += n;
+    if (block < MAX_DIFF_BLOCK)
+      block *= 2;
+  }
+  return done;
+}
+
+/* DoDiff() over two mapped files. the common run of bytes from a pair
+   of lines is skipped with CommonPrefix() up to its last whole line,
+   counting the lines, and only the pair of lines after it is compared
+   line by line. returns -1 when a file cannot be mapped, so the caller
+   reads them instead */
+static int
+DiffMapped(int fd1, int fd2, const char *file1, const char *file2)
+{
+  const char *map1, *map2, *p1, *p2, *end1, *end2;
+  size_t size1, size2;
+  unsigned long line_no = 1;
+  int ret = TRUE;
+
+  if (!MapFile(fd1, &map1, &size1))
+    return -1;
+  if (!MapFile(fd2, &map2, &size2)) {
+    if (map1)
+      munmap((void *)map1, size1);
+    return -1;
+  }
+
+  p1 = map1;
+  p2 = map2;
+  end1 = map1 + size1;
+  end2 = map2 + size2;
+
+  while (TRUE) {
+    size_t common, len1, len2;
+    const char *q1, *q2, *pcNl;
+
+    /* the equal lines from here on need not be looked at one by one */
+    if ((size_t)(end1 - p1) < (size_t)(end2 - p2))
+      common = CommonPrefix(p1, p2, end1 - p1);
+    else
+      common = CommonPrefix(p1, p2, end2 - p2);
+    while (common > 0 && p1[common - 1] != '\n')
+      common--;
+    line_no += CountLines(p1, common);
+    p1 += common;
+    p2 += common;
+
+    if (p1 == end1 && p2 < end2) {
+      fprintf(stderr, "Error: %s ends early at line %lu\n",file1,line_no);
+      ret = FALSE;
+      break;
+    }
+    if (p2 == end2 && p1 < end1) {
+      fprintf(stderr, "Error: %s ends early at line %lu\n",file2,line_no);
+      ret = FALSE;
+      break;
+    }
+    if (p1 == end1 && p2 == end2)
+      break;
+
+    /* one pair of lines, as the line by line diff compares them */
+    q1 = (pcNl = memchr(p1, '\n', end1 - p1)) ? pcNl + 1 : end1;
+    q2 = (pcNl = memchr(p2, '\n', end2 - p2)) ? pcNl + 1 : end2;
+    len1 = LineLength (p1, q1 - p1);
+    len2 = LineLength (p2, q2 - p2);
+    if (len1 != len2 || memcmp (p1, p2, len1)) {
+      printf("%s@%lu:",file1, line_no);
+      fwrite(p1, 1, len1, stdout);
+      printf("%s@%lu:",file2, line_no);
+      fwrite(p2, 1, len2, stdout);
+    }
+    line_no++;
+    p1 = q1;
+    p2 = q2;
+  }
+
+  if (map1)
+    munmap((void *)map1, size1);
+  if (map2)
+    munmap((void *)map2, size2);
+  return ret;
+}
+
 /*reads a line by line from two files, prints all lines that are different*/
 int
-DoDiff(const char *file1, const char *file2)
+DoDiff(const char *file1, const char *file2, const Options *opts)
 {
-  
-  char buf1[MAX_STR_LEN + 1];
-  char buf2[MAX_STR_LEN + 1];
+  LineReader reader1, reader2;
+  char *line1, *line2;
+  size_t len1, len2;
   unsigned long line_no = 1;
+  int fd1, fd2, ret = TRUE;
 
   /* validate arguments */
   if (StrGetLength (file1) > MAX_STR_LEN || StrGetLength (file2) > MAX_STR_LEN) {
@@ -227,48 +2053,83 @@ DoDiff(const char *file1, const char *file2)
     return FALSE;
   }
 
+  if (opts->unified)
+    return DoUnifiedDiff(file1, file2);
+
   /* open the two files */
-  FILE *fp1 = fopen (file1, "r");
-  if (!fp1) {
+  if ((fd1 = open (file1, O_RDONLY)) < 0) {
     fprintf(stderr, "Error: failed to open file %s\n",file1);
     return FALSE;
   }
 
-  FILE *fp2 = fopen (file2, "r");
-  if (!fp2) {
+  if ((fd2 = open (file2, O_RDONLY)) < 0) {
     fprintf(stderr, "Error: failed to open file %s\n",file2);
+    close (fd1);
+    return FALSE;
+  }
+
+  /* regular files are compared in place, others read line by line */
+  if ((ret = DiffMapped (fd1, fd2, file1, file2)) >= 0) {
+    close (fd1);
+    close (fd2);
+    return ret;
+  }
+  ret = TRUE;
+
+  if (!LineReader_init (&reader1, fd1)) {
+    close (fd1);
+    close (fd2);
+    return FALSE;
+  }
+  if (!LineReader_init (&reader2, fd2)) {
+    LineReader_free (&reader1);
+    close (fd1);
+    close (fd2);
     return FALSE;
   }
 
   while (TRUE) {
-    char *r1 = fgets (buf1, sizeof(buf1), fp1);
-    char *r2 = fgets (buf2, sizeof(buf2), fp2);
+    int r1 = LineReader_next (&reader1, &line1, &len1);
+    int r2 = LineReader_next (&reader2, &line2, &len2);
+
+    if (reader1.error || reader2.error) {
+      ret = FALSE;
+      break;
+    }
 
     if (!r1 && r2) {
       fprintf(stderr, "Error: %s ends early at line %lu\n",file1,line_no);
-      return FALSE;
+      ret = FALSE;
+      break;
     }
 
     if (!r2 && r1) {
       fprintf(stderr, "Error: %s ends early at line %lu\n",file2,line_no);
-      return FALSE;
+      ret = FALSE;
+      break;
     }
 
     if (!r1 && !r2) {
       break;
     }
 
-    if (StrCompare (buf1, buf2)) {
-      printf("%s@%lu:%s",file1, line_no, buf1);
-      printf("%s@%lu:%s",file2, line_no, buf2);
+    len1 = LineLength (line1, len1);
+    len2 = LineLength (line2, len2);
+    if (len1 != len2 || memcmp (line1, line2, len1)) {
+      printf("%s@%lu:",file1, line_no);
+      fwrite(line1, 1, len1, stdout);
+      printf("%s@%lu:",file2, line_no);
+      fwrite(line2, 1, len2, stdout);
     }
 
     line_no++;
   }
 
-
-
-  return TRUE;
+  LineReader_free (&reader1);
+  LineReader_free (&reader2);
+  close (fd1);
+  close (fd2);
+  return ret;
 }
 /*-------------------------------------------------------------------*/
 /* CommandCheck() 
@@ -284,7 +2145,11 @@ int
 CommandCheck(const int argc, const char *argv1)
 {
   int cmdtype = INVALID;
-   
+
+  /* the search strings of multi-find may all come from a -p file */
+  if (argc >= 2 && strcmp(argv1, MULTIFIND_STR) == 0)
+    return MULTIFIND;
+
   /* check minimum number of argument */
   if (argc < 3)
     return cmdtype;
@@ -305,32 +2170,111 @@ CommandCheck(const int argc, const char *argv1)
       return FALSE;
     cmdtype = DIFF;
   }
+  else if (strcmp(argv1, REGEX_STR) == 0) {
+    if (argc != 3)
+      return FALSE;
+    cmdtype = REGEX;
+  }
+  else if (strcmp(argv1, INPLACE_STR) == 0) {
+    if (argc < 5)
+      return FALSE;
+    cmdtype = INPLACE;
+  }
+  else if (strcmp(argv1, RULES_STR) == 0) {
+    if (argc != 3)
+      return FALSE;
+    cmdtype = RULES;
+  }
    
   return cmdtype;
 }
 /*-------------------------------------------------------------------*/
+/* OptionCheck()
+   - Parse the options given before the command into opts.
+   - It returns the number of arguments the options took, or -1 if
+     an option lacks its argument.                                   */
+/*-------------------------------------------------------------------*/
+int
+OptionCheck(const int argc, const char *argv[], Options *opts)
+{
+  int i;
+
+  memset(opts, 0, sizeof(*opts));
+
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], MMAP_OPT_STR) == 0)
+      opts->mmap = TRUE;
+    else if (strcmp(argv[i], TAG_OPT_STR) == 0)
+      opts->tag = TRUE;
+    else if (strcmp(argv[i], UNIFIED_OPT_STR) == 0)
+      opts->unified = TRUE;
+    else if (strcmp(argv[i], ICASE_OPT_STR) == 0)
+      opts->flags |= STR_ICASE;
+    else if (strcmp(argv[i], WORD_OPT_STR) == 0)
+      opts->flags |= STR_WORD;
+    else if (strcmp(argv[i], COUNT_OPT_STR) == 0)
+      opts->count = TRUE;
+    else if (strcmp(argv[i], NUMBER_OPT_STR) == 0)
+      opts->number = TRUE;
+    else if (strcmp(argv[i], OFFSET_OPT_STR) == 0)
+      opts->offset = TRUE;
+    else if (strcmp(argv[i], JOBS_OPT_STR) == 0) {
+      if (++i == argc)
+        return -1;
+      opts->jobs = atoi(argv[i]);
+      if (opts->jobs < 1 || opts->jobs > MAX_THREADS)
+        return -1;
+    }
+    else if (strcmp(argv[i], PATFILE_OPT_STR) == 0) {
+      if (++i == argc)
+        return -1;
+      opts->patfile = argv[i];
+    }
+    else
+      break;
+  }
+
+  return i - 1;
+}
+/*-------------------------------------------------------------------*/
 int 
 main(const int argc, const char *argv[]) 
 {
-  int type, ret;
-   
+  int type, ret = FALSE, nopts;
+  Options opts;
+  const char **args;
+
   /* Do argument check and parsing */
-  if (!(type = CommandCheck(argc, argv[1]))) {
+  if ((nopts = OptionCheck(argc, argv, &opts)) < 0 ||
+      !(type = CommandCheck(argc - nopts, argv[nopts + 1]))) {
     fprintf(stderr, "Error: argument parsing error\n");
     PrintUsage(argv[0]);
     return (EXIT_FAILURE);
   }
+  args = argv + nopts;
    
   /* Do appropriate job */
   switch (type) {
   case FIND:
-    ret = DoFind(argv[2]);
+    ret = DoFind(args[2], &opts);
     break;
   case REPLACE:
-    ret = DoReplace(argv[2], argv[3]);
+    ret = DoReplace(args[2], args[3], &opts);
     break;
   case DIFF:
-    ret = DoDiff(argv[2], argv[3]);
+    ret = DoDiff(args[2], args[3], &opts);
+    break;
+  case MULTIFIND:
+    ret = DoMultiFind(argc - nopts - 2, args + 2, &opts);
+    break;
+  case REGEX:
+    ret = DoRegexFind(args[2], &opts);
+    break;
+  case INPLACE:
+    ret = DoReplaceFiles(args[2], args[3], argc - nopts - 4, args + 4, &opts);
+    break;
+  case RULES:
+    ret = DoReplaceRules(args[2], &opts);
     break;
   } 
 
@@ -4,8 +4,15 @@ Assignment.2
 
 #include <assert.h> /* to use assert() */
 #include <stdio.h>
+#include <stdlib.h> /* for malloc() */
+#include <stdint.h> /* for uintptr_t */
 #include "str.h"
 
+#if defined(__SSE2__)
+#include <immintrin.h>
+#define HAVE_SIMD 1
+#endif
+
 /* Your task is: 
    1. Rewrite the body of "Part 1" functions - remove the current
       body that simply calls the corresponding C standard library
@@ -13,89 +20,971 @@ Assignment.2
    2. Write appropriate comment per each function
 */
 
+/* Kernels */
+/*------------------------------------------------------------------------*/
+/* Part 1 and the matchers run on the kernels below. each has a portable
+   version and, on x86, SSE2 and AVX2 versions, picked by CPU dispatch on
+   the first call. vector loads of a string are aligned, so they never
+   cross into a page the string does not reach */
+
+#define PAGE_SIZE 4096
+
+/* the aligned reads may pass the end of the string within its page,
+   which the address sanitizer would report */
+#define ALIGNED_READ __attribute__((no_sanitize_address))
+
+#ifndef HAVE_SIMD
+/* 0x01 and 0x80 in every byte of a word */
+#define WORD_ONES ((size_t)-1 / 0xff)
+#define WORD_HIGHS (WORD_ONES * 0x80)
+/* nonzero if the word w holds a zero byte */
+#define WORD_HAS_ZERO(w) (((w) - WORD_ONES) & ~(w) & WORD_HIGHS)
+
+/* length of pcSrc, a word at a time once aligned */
+ALIGNED_READ
+static size_t GetLengthWord(const char *pcSrc)
+{
+  const char *p = pcSrc;
+  const size_t *w;
+
+  while ((uintptr_t)p % sizeof(size_t)) {
+    if (!*p) {
+      return (size_t)(p - pcSrc);
+    }
+    p++;
+  }
+
+  for (w = (const size_t *)p; !WORD_HAS_ZERO(*w); w++)
+    ;
+
+  for (p = (const char *)w; *p; p++)
+    ;
+  return (size_t)(p - pcSrc);
+}
+#endif
+
+/* first byte c in the len bytes at p, or NULL */
+static const char *FindByteScalar(const char *p, int c, size_t len)
+{
+  const char *pcEnd = p + len;
+
+  for (; p < pcEnd; p++) {
+    if (*p == (char)c) {
+      return p;
+    }
+  }
+  return NULL;
+}
+
+/* copies len bytes from pcSrc to pcDest */
+static void CopyScalar(char *pcDest, const char *pcSrc, size_t len)
+{
+  size_t i;
+
+  for (i = 0; i < len; i++) {
+    pcDest[i] = pcSrc[i];
+  }
+}
+
+#ifndef HAVE_SIMD
+/* difference of the first pair of different chars, 0 if equal */
+static int CompareScalar(const char *pcS1, const char *pcS2)
+{
+  while (*pcS1 && *pcS1 == *pcS2) {
+    pcS1++;
+    pcS2++;
+  }
+  return *pcS1 - *pcS2;
+}
+#endif
+
+#ifdef HAVE_SIMD
+ALIGNED_READ
+static size_t GetLengthSSE2(const char *pcSrc)
+{
+  /* round down to 16, and drop the bytes before pcSrc from the mask */
+  const char *p = (const char *)((uintptr_t)pcSrc & ~(uintptr_t)15);
+  unsigned mask = _mm_movemask_epi8(
+    _mm_cmpeq_epi8(_mm_load_si128((const __m128i *)p), _mm_setzero_si128()));
+
+  mask >>= pcSrc - p;
+  if (mask) {
+    return __builtin_ctz(mask);
+  }
+
+  for (p += 16; ; p += 16) {
+    mask = _mm_movemask_epi8(
+      _mm_cmpeq_epi8(_mm_load_si128((const __m128i *)p), _mm_setzero_si128()));
+    if (mask) {
+      return (size_t)(p - pcSrc) + __builtin_ctz(mask);
+    }
+  }
+}
+
+static const char *FindByteSSE2(const char *p, int c, size_t len)
+{
+  const char *pcEnd = p + len;
+  __m128i needle = _mm_set1_epi8((char)c);
+
+  for (; pcEnd - p >= 16; p += 16) {
+    unsigned mask = _mm_movemask_epi8(
+      _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)p), needle));
+    if (mask) {
+      return p + __builtin_ctz(mask);
+    }
+  }
+  return FindByteScalar(p, c, pcEnd - p);
+}
+
+static void CopySSE2(char *pcDest, const char *pcSrc, size_t len)
+{
+  size_t i;
+
+  for (i = 0; i + 16 <= len; i += 16) {
+    _mm_storeu_si128((__m128i *)(pcDest + i),
+                     _mm_loadu_si128((const __m128i *)(pcSrc + i)));
+  }
+  CopyScalar(pcDest + i, pcSrc + i, len - i);
+}
+
+ALIGNED_READ
+static int CompareSSE2(const char *pcS1, const char *pcS2)
+{
+  /* bytewise until pcS1 is aligned */
+  while ((uintptr_t)pcS1 % 16) {
+    if (!*pcS1 || *pcS1 != *pcS2) {
+      return *pcS1 - *pcS2;
+    }
+    pcS1++;
+    pcS2++;
+  }
+
+  for (;;) {
+    __m128i a, b;
+    unsigned stop;
+
+    /* the unaligned load of pcS2 must not run into the next page */
+    if ((uintptr_t)pcS2 % PAGE_SIZE > PAGE_SIZE - 16) {
+      int i;
+      for (i = 0; i < 16; i++) {
+        if (!pcS1[i] || pcS1[i] != pcS2[i]) {
+          return pcS1[i] - pcS2[i];
+        }
+      }
+      pcS1 += 16;
+      pcS2 += 16;
+      continue;
+    }
+
+    a = _mm_load_si128((const __m128i *)pcS1);
+    b = _mm_loadu_si128((const __m128i *)pcS2);
+    /* stop at the first byte that differs or ends pcS1 */
+    stop = ~_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) & 0xffff;
+    stop |= _mm_movemask_epi8(_mm_cmpeq_epi8(a, _mm_setzero_si128()));
+    if (stop) {
+      int i = __builtin_ctz(stop);
+      return pcS1[i] - pcS2[i];
+    }
+    pcS1 += 16;
+    pcS2 += 16;
+  }
+}
+
+__attribute__((target("avx2"))) ALIGNED_READ
+static size_t GetLengthAVX2(const char *pcSrc)
+{
+  const char *p = (const char *)((uintptr_t)pcSrc & ~(uintptr_t)31);
+  unsigned mask = _mm256_movemask_epi8(
+    _mm256_cmpeq_epi8(_mm256_load_si256((const __m256i *)p),
+                      _mm256_setzero_si256()));
+
+  mask >>= pcSrc - p;
+  if (mask) {
+    return __builtin_ctz(mask);
+  }
+
+  for (p += 32; ; p += 32) {
+    mask = _mm256_movemask_epi8(
+      _mm256_cmpeq_epi8(_mm256_load_si256((const __m256i *)p),
+                        _mm256_setzero_si256()));
+    if (mask) {
+      return (size_t)(p - pcSrc) + __builtin_ctz(mask);
+    }
+  }
+}
+
+__attribute__((target("avx2")))
+static const char *FindByteAVX2(const char *p, int c, size_t len)
+{
+  const char *pcEnd = p + len;
+  __m256i needle = _mm256_set1_epi8((char)c);
+
+  for (; pcEnd - p >= 32; p += 32) {
+    unsigned mask = _mm256_movemask_epi8(
+      _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)p), needle));
+    if (mask) {
+      return p + __builtin_ctz(mask);
+    }
+  }
+  return FindByteSSE2(p, c, pcEnd - p);
+}
+
+__attribute__((target("avx2")))
+static void CopyAVX2(char *pcDest, const char *pcSrc, size_t len)
+{
+  size_t i;
+
+  for (i = 0; i + 32 <= len; i += 32) {
+    _mm256_storeu_si256((__m256i *)(pcDest + i),
+                        _mm256_loadu_si256((const __m256i *)(pcSrc + i)));
+  }
+  CopySSE2(pcDest + i, pcSrc + i, len - i);
+}
+
+__attribute__((target("avx2"))) ALIGNED_READ
+static int CompareAVX2(const char *pcS1, const char *pcS2)
+{
+  while ((uintptr_t)pcS1 % 32) {
+    if (!*pcS1 || *pcS1 != *pcS2) {
+      return *pcS1 - *pcS2;
+    }
+    pcS1++;
+    pcS2++;
+  }
+
+  for (;;) {
+    __m256i a, b;
+    unsigned stop;
+
+    if ((uintptr_t)pcS2 % PAGE_SIZE > PAGE_SIZE - 32) {
+      int i;
+      for (i = 0; i < 32; i++) {
+        if (!pcS1[i] || pcS1[i] != pcS2[i]) {
+          return pcS1[i] - pcS2[i];
+        }
+      }
+      pcS1 += 32;
+      pcS2 += 32;
+      continue;
+    }
+
+    a = _mm256_load_si256((const __m256i *)pcS1);
+    b = _mm256_loadu_si256((const __m256i *)pcS2);
+    stop = ~(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b));
+    stop |= (unsigned)_mm256_movemask_epi8(
+      _mm256_cmpeq_epi8(a, _mm256_setzero_si256()));
+    if (stop) {
+      int i = __builtin_ctz(stop);
+      return pcS1[i] - pcS2[i];
+    }
+    pcS1 += 32;
+    pcS2 += 32;
+  }
+}
+#endif /* HAVE_SIMD */
+
+static void ResolveKernels(void);
+
+static size_t GetLengthResolve(const char *pcSrc);
+static const char *FindByteResolve(const char *p, int c, size_t len);
+static void CopyResolve(char *pcDest, const char *pcSrc, size_t len);
+static int CompareResolve(const char *pcS1, const char *pcS2);
+
+/* the kernels for this CPU. each starts at a resolver that fills in all
+   of them on the first call */
+static size_t (*pfGetLength)(const char *) = GetLengthResolve;
+static const char *(*pfFindByte)(const char *, int, size_t) = FindByteResolve;
+static void (*pfCopy)(char *, const char *, size_t) = CopyResolve;
+static int (*pfCompare)(const char *, const char *) = CompareResolve;
+
+static void ResolveKernels(void)
+{
+#ifdef HAVE_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    pfGetLength = GetLengthAVX2;
+    pfFindByte = FindByteAVX2;
+    pfCopy = CopyAVX2;
+    pfCompare = CompareAVX2;
+  }
+  else {
+    pfGetLength = GetLengthSSE2;
+    pfFindByte = FindByteSSE2;
+    pfCopy = CopySSE2;
+    pfCompare = CompareSSE2;
+  }
+#else
+  pfGetLength = GetLengthWord;
+  pfFindByte = FindByteScalar;
+  pfCopy = CopyScalar;
+  pfCompare = CompareScalar;
+#endif
+}
+
+static size_t GetLengthResolve(const char *pcSrc)
+{
+  ResolveKernels();
+  return pfGetLength(pcSrc);
+}
+
+static const char *FindByteResolve(const char *p, int c, size_t len)
+{
+  ResolveKernels();
+  return pfFindByte(p, c, len);
+}
+
+static void CopyResolve(char *pcDest, const char *pcSrc, size_t len)
+{
+  ResolveKernels();
+  pfCopy(pcDest, pcSrc, len);
+}
+
+static int CompareResolve(const char *pcS1, const char *pcS2)
+{
+  ResolveKernels();
+  return pfCompare(pcS1, pcS2);
+}
+
 /* Part 1 */
 /*------------------------------------------------------------------------*/
+/*returns the number of chars before the terminating null character*/
 size_t StrGetLength(const char* pcSrc)
 {
-  const char *pcEnd;
   assert(pcSrc); /* NULL address, 0, and FALSE are identical. */
-  pcEnd = pcSrc;
-	
-  while (*pcEnd) /* null character and FALSE are identical. */
-    pcEnd++;
-
-  return (size_t)(pcEnd - pcSrc);
+  return pfGetLength (pcSrc);
 }
 
 /*takes a dest pointer and source string, and copies the content of the string to the destination pointer*/
 char *StrCopy(char *pcDest, const char* pcSrc)
 {
-  /* TODO: fill this function */
   assert (pcDest);
   assert (pcSrc);
 
-  unsigned long length = StrGetLength (pcSrc);
-  unsigned long i = 0;
+  /* the terminating null character is copied along */
+  pfCopy (pcDest, pcSrc, StrGetLength (pcSrc) + 1);
+  return pcDest;
+}
 
-  for (i=0; i < length; i++) {
-    pcDest[i] = pcSrc[i];
+/*takes two strings and compares them, returns zero if two are identical and
+  otherwise the difference of the first two different chars, as chars*/
+int StrCompare(const char* pcS1, const char* pcS2)
+{
+  assert (pcS1);
+  assert (pcS2);
+  return pfCompare (pcS1, pcS2);
+}
+
+/*searches string Needle within string Haystack, returns a pointer to the
+  first occurrence or NULL. an empty Needle is found at the start*/
+char *StrSearch(const char* pcHaystack, const char *pcNeedle)
+{
+  const char *p, *pcLast;
+  size_t haystack_len;
+  size_t needle_len;
+  size_t j;
+
+  assert (pcHaystack);
+  assert (pcNeedle);
+
+  haystack_len = StrGetLength (pcHaystack);
+  needle_len = StrGetLength (pcNeedle);
+
+  if (needle_len == 0) {
+    return (char *)pcHaystack;
+  }
+  if (needle_len > haystack_len) {
+    return NULL;
+  }
+
+  /* jump between candidates with the first-byte scan */
+  p = pcHaystack;
+  pcLast = pcHaystack + haystack_len - needle_len;
+  while ((p = pfFindByte (p, pcNeedle[0], pcLast - p + 1))) {
+    for (j = 1; j < needle_len; j++) {
+      if (p[j] != pcNeedle[j]) {
+        break;
+      }
+    }
+    if (j == needle_len) {
+      return (char *)p;
+    }
+    p++;
   }
 
-  pcDest[length] = 0;
+  return NULL;
+}
+/*concatenates pcSrc to pcDest*/
+char *StrConcat(char *pcDest, const char* pcSrc)
+{
+  assert (pcDest);
+  assert (pcSrc);
 
+  StrCopy (pcDest + StrGetLength (pcDest), pcSrc);
   return pcDest;
 }
 
-/*takes two strings and compares them, returns zero if two are identical and a nonzero value if the two are not identical*/
-int StrCompare(const char* pcS1, const char* pcS2)
+/* Part 2 */
+/*------------------------------------------------------------------------*/
+/* ASCII case folding and word bytes, as in the C locale */
+#define FOLD(c) (((c) >= 'A' && (c) <= 'Z') ? (c) - 'A' + 'a' : (c))
+#define IS_WORD(c) (((c) >= 'a' && (c) <= 'z') || ((c) >= 'A' && (c) <= 'Z') \
+                    || ((c) >= '0' && (c) <= '9') || (c) == '_')
+
+/*returns whether the m bytes at h + i, within the len bytes at h, have
+  no word byte right before or after them*/
+static int IsWordAt(const unsigned char *h, size_t len, size_t i, size_t m)
+{
+  return (i == 0 || !IS_WORD(h[i - 1])) &&
+         (i + m == len || !IS_WORD(h[i + m]));
+}
+
+/* a needle prepared for Boyer-Moore-Horspool search. shift[c] is how far
+   the window may move when its last byte is c. with STR_ICASE the needle
+   is kept folded, and a letter shifts as far in either case */
+struct StrMatcher {
+  char *pcNeedle;
+  size_t len;
+  int flags;
+  size_t shift[256];
+};
+
+/*builds the skip table of pcNeedle, returns NULL if out of memory*/
+StrMatcher_T StrMatcher_new(const char *pcNeedle)
 {
-  unsigned long len1 = StrGetLength (pcS1);
-  unsigned long len2 = StrGetLength (pcS2);
-  unsigned long cmplen = len2;
-  unsigned long i = 0;
+  return StrMatcher_newFlags (pcNeedle, 0);
+}
+
+/*builds the skip table of pcNeedle to be searched for as flags, a set
+  of STR_ICASE and STR_WORD, say. returns NULL if out of memory*/
+StrMatcher_T StrMatcher_newFlags(const char *pcNeedle, int flags)
+{
+  StrMatcher_T oMatcher;
+  size_t i;
+
+  assert (pcNeedle);
 
-  if (len2 < len1) {
-    cmplen = len1;
+  oMatcher = malloc (sizeof(*oMatcher));
+  if (!oMatcher) {
+    return NULL;
   }
 
-  for (i=0; i < cmplen; i++) {
-    if (pcS1[i]-pcS2[i]) {
-      return pcS1[i]-pcS2[i];
+  oMatcher->len = StrGetLength (pcNeedle);
+  oMatcher->pcNeedle = malloc (oMatcher->len + 1);
+  if (!oMatcher->pcNeedle) {
+    free (oMatcher);
+    return NULL;
+  }
+  StrCopy (oMatcher->pcNeedle, pcNeedle);
+  oMatcher->flags = flags;
+  if (flags & STR_ICASE) {
+    for (i = 0; i < oMatcher->len; i++) {
+      oMatcher->pcNeedle[i] = FOLD (oMatcher->pcNeedle[i]);
+    }
+  }
+
+  /* a byte absent from the needle lets the window jump past it */
+  for (i = 0; i < 256; i++) {
+    oMatcher->shift[i] = oMatcher->len;
+  }
+  /* the last byte itself is left out, it would give a shift of 0 */
+  for (i = 0; i + 1 < oMatcher->len; i++) {
+    unsigned char c = oMatcher->pcNeedle[i];
+    oMatcher->shift[c] = oMatcher->len - 1 - i;
+    if ((flags & STR_ICASE) && c >= 'a' && c <= 'z') {
+      oMatcher->shift[c - 'a' + 'A'] = oMatcher->len - 1 - i;
     }
   }
 
-  assert (len1 == len2);
-  return 0;
+  return oMatcher;
 }
-/*searches string Needle within string Haystack*/
-char *StrSearch(const char* pcHaystack, const char *pcNeedle)
+
+/*StrMatcher_search with flags from h + start on, for a needle no longer
+  than len - start. a window that fails the word check moves on by the
+  same shift as one that does not match*/
+static char *StrMatcher_searchFlags(StrMatcher_T oMatcher,
+                                    const unsigned char *h, size_t len,
+                                    size_t start)
 {
-  unsigned long haystack_len = StrGetLength (pcHaystack);
-  unsigned long needle_len = StrGetLength (pcNeedle);
-  unsigned long i,j;
-  for (i=0; i < haystack_len - needle_len; i++) {
-    for (j=0; j < needle_len; j++) {
-      if (pcHaystack[i+j]!=pcNeedle[j]){
+  const unsigned char *n = (const unsigned char *)oMatcher->pcNeedle;
+  size_t m = oMatcher->len, last = m - 1, i, j;
+  int icase = oMatcher->flags & STR_ICASE;
+  int word = oMatcher->flags & STR_WORD;
+
+  for (i = start; i <= len - m; i += oMatcher->shift[h[i + last]]) {
+    for (j = 0; j < m; j++) {
+      unsigned char c = h[i + (last - j)];
+      if ((icase ? FOLD (c) : c) != n[last - j]) {
         break;
       }
     }
-
-    if (j == needle_len) {
-      char *ptr = (char *)pcHaystack;
-      return &ptr[i];
+    if (j == m && (!word || IsWordAt (h, len, i, m))) {
+      return (char *)(h + i);
     }
+  }
+
+  return NULL;
+}
+
+/*frees a matcher made by StrMatcher_new*/
+void StrMatcher_free(StrMatcher_T oMatcher)
+{
+  if (!oMatcher) {
+    return;
+  }
+  free (oMatcher->pcNeedle);
+  free (oMatcher);
+}
+
+/*returns the length of the needle of oMatcher*/
+size_t StrMatcher_getLength(StrMatcher_T oMatcher)
+{
+  assert (oMatcher);
+  return oMatcher->len;
+}
+
+/*searches the needle of oMatcher within the len bytes at pcHaystack, which
+  need not be null-terminated. returns the first occurrence or NULL. with
+  STR_ICASE letters match in either case, and with STR_WORD only an
+  occurrence with no word byte on either side counts*/
+char *StrMatcher_search(StrMatcher_T oMatcher, const char *pcHaystack,
+                        size_t len)
+{
+  const unsigned char *h = (const unsigned char *)pcHaystack;
+  const char *n;
+  size_t m, last, i, j;
+  int flags;
+
+  assert (oMatcher);
+  assert (pcHaystack);
 
+  n = oMatcher->pcNeedle;
+  m = oMatcher->len;
+  flags = oMatcher->flags;
+
+  if (m == 0) {
+    return (char *)pcHaystack;
+  }
+  if (m > len) {
+    return NULL;
+  }
+  if (flags) {
+    return StrMatcher_searchFlags (oMatcher, h, len, 0);
+  }
+  if (m == 1) {
+    return (char *)pfFindByte (pcHaystack, n[0], len);
+  }
+
+  last = m - 1;
+  for (i = 0; i <= len - m; i += oMatcher->shift[h[i + last]]) {
+    /* compare the last byte first, then the rest */
+    if (h[i + last] != (unsigned char)n[last]) {
+      continue;
+    }
+    for (j = 0; j < last; j++) {
+      if (h[i + j] != (unsigned char)n[j]) {
+        break;
+      }
+    }
+    if (j == last) {
+      return (char *)(h + i);
+    }
   }
 
   return NULL;
 }
-/*concatenates pcSrc to pcDest*/
-char *StrConcat(char *pcDest, const char* pcSrc)
+
+/*StrMatcher_search over the bytes from pcText + start to pcText + len,
+  where the bytes before start are still seen by the STR_WORD check*/
+char *StrMatcher_searchAt(StrMatcher_T oMatcher, const char *pcText,
+                          size_t len, size_t start)
 {
-  assert (pcSrc);
+  assert (oMatcher);
+  assert (pcText);
+  assert (start <= len);
 
-  unsigned long len1 = StrGetLength (pcDest);
-  char *ptr = &pcDest[len1];
-  StrCopy (ptr, pcSrc);
-  return pcDest;
+  if (!(oMatcher->flags & STR_WORD)) {
+    return StrMatcher_search (oMatcher, pcText + start, len - start);
+  }
+  if (oMatcher->len == 0 || oMatcher->len > len - start) {
+    return oMatcher->len ? NULL : (char *)pcText + start;
+  }
+  return StrMatcher_searchFlags (oMatcher, (const unsigned char *)pcText,
+                                 len, start);
+}
+
+/* Part 3 */
+/*------------------------------------------------------------------------*/
+/* a set of needles searched for together by an Aho-Corasick automaton.
+   the needles first go into a trie of linked child lists, which
+   StrSet_compile turns into a dense transition table over the byte
+   classes that occur in the needles */
+
+/* a trie node while the set is built */
+struct StrSetNode {
+  int child;             /* first child, -1 if none */
+  int sibling;           /* next child of the same parent, -1 if none */
+  unsigned char byte;    /* byte on the edge from the parent */
+  int pattern;           /* needle ending here, -1 if none */
+};
+
+struct StrSet {
+  char **ppcPatterns;    /* copies of the needles, in order added */
+  size_t *lens;
+  int count, patcap;
+  int flags;             /* STR_ICASE folds the trie, STR_WORD */
+  size_t maxlen;         /* length of the longest needle */
+
+  struct StrSetNode *nodes;
+  int nstates, nodecap;
+
+  /* filled by StrSet_compile */
+  int compiled;
+  int nclasses;
+  unsigned char byte_class[256];  /* 0 for bytes in no needle */
+  int *delta;            /* next state, nclasses entries per state */
+  int *match;            /* longest needle that is a suffix of the state */
+  int *shorter;          /* per needle, its longest suffix that is one */
+};
+
+/*returns an empty set, or NULL if out of memory*/
+StrSet_T StrSet_new(void)
+{
+  return StrSet_newFlags (0);
+}
+
+/*returns an empty set searched for as flags, or NULL if out of memory*/
+StrSet_T StrSet_newFlags(int flags)
+{
+  StrSet_T oSet = calloc (1, sizeof(*oSet));
+
+  if (!oSet) {
+    return NULL;
+  }
+  oSet->flags = flags;
+
+  /* the root */
+  oSet->nodecap = 64;
+  oSet->nodes = malloc (oSet->nodecap * sizeof(*oSet->nodes));
+  if (!oSet->nodes) {
+    free (oSet);
+    return NULL;
+  }
+  oSet->nodes[0].child = oSet->nodes[0].sibling = -1;
+  oSet->nodes[0].byte = 0;
+  oSet->nodes[0].pattern = -1;
+  oSet->nstates = 1;
+
+  return oSet;
+}
+
+/*frees a set made by StrSet_new*/
+void StrSet_free(StrSet_T oSet)
+{
+  int i;
+
+  if (!oSet) {
+    return;
+  }
+  for (i = 0; i < oSet->count; i++) {
+    free (oSet->ppcPatterns[i]);
+  }
+  free (oSet->ppcPatterns);
+  free (oSet->lens);
+  free (oSet->nodes);
+  free (oSet->delta);
+  free (oSet->match);
+  free (oSet->shorter);
+  free (oSet);
+}
+
+/* child of state s on byte c, made if absent. -1 if out of memory */
+static int StrSet_child(StrSet_T oSet, int s, unsigned char c)
+{
+  struct StrSetNode *node;
+  int t;
+
+  for (t = oSet->nodes[s].child; t >= 0; t = oSet->nodes[t].sibling) {
+    if (oSet->nodes[t].byte == c) {
+      return t;
+    }
+  }
+
+  if (oSet->nstates == oSet->nodecap) {
+    node = realloc (oSet->nodes, 2 * oSet->nodecap * sizeof(*node));
+    if (!node) {
+      return -1;
+    }
+    oSet->nodes = node;
+    oSet->nodecap *= 2;
+  }
+
+  t = oSet->nstates++;
+  node = &oSet->nodes[t];
+  node->child = -1;
+  node->sibling = oSet->nodes[s].child;
+  node->byte = c;
+  node->pattern = -1;
+  oSet->nodes[s].child = t;
+  return t;
+}
+
+/*adds the len bytes at pcPattern to an uncompiled set. len must not be 0.
+  returns the index of the needle, that of the earlier copy if it was
+  added before, or -1 if out of memory*/
+int StrSet_add(StrSet_T oSet, const char *pcPattern, size_t len)
+{
+  size_t i;
+  int s = 0;
+
+  assert (oSet);
+  assert (pcPattern);
+  assert (len > 0);
+  assert (!oSet->compiled);
+
+  for (i = 0; i < len; i++) {
+    unsigned char c = pcPattern[i];
+    if (oSet->flags & STR_ICASE) {
+      c = FOLD (c);
+    }
+    if ((s = StrSet_child (oSet, s, c)) < 0) {
+      return -1;
+    }
+  }
+  if (oSet->nodes[s].pattern >= 0) {
+    return oSet->nodes[s].pattern;
+  }
+
+  if (oSet->count == oSet->patcap) {
+    int cap = oSet->patcap ? 2 * oSet->patcap : 16;
+    char **pp = realloc (oSet->ppcPatterns, cap * sizeof(*pp));
+    size_t *lens;
+
+    if (!pp) {
+      return -1;
+    }
+    oSet->ppcPatterns = pp;
+    if (!(lens = realloc (oSet->lens, cap * sizeof(*lens)))) {
+      return -1;
+    }
+    oSet->lens = lens;
+    oSet->patcap = cap;
+  }
+
+  if (!(oSet->ppcPatterns[oSet->count] = malloc (len + 1))) {
+    return -1;
+  }
+  pfCopy (oSet->ppcPatterns[oSet->count], pcPattern, len);
+  oSet->ppcPatterns[oSet->count][len] = '\0';
+  oSet->lens[oSet->count] = len;
+  if (len > oSet->maxlen) {
+    oSet->maxlen = len;
+  }
+
+  oSet->nodes[s].pattern = oSet->count;
+  return oSet->count++;
+}
+
+/*builds the automaton of the needles added so far. after this no needle
+  may be added. returns 0 if out of memory*/
+int StrSet_compile(StrSet_T oSet)
+{
+  int *queue, *fail;
+  int nclasses, head, tail, s, t, c;
+
+  assert (oSet);
+  assert (!oSet->compiled);
+
+  /* one class per byte that occurs in a needle, all others share 0.
+     folded, a letter has one class for both cases */
+  nclasses = 1;
+  for (s = 1; s < oSet->nstates; s++) {
+    unsigned char b = oSet->nodes[s].byte;
+    if (!oSet->byte_class[b]) {
+      oSet->byte_class[b] = nclasses++;
+      if ((oSet->flags & STR_ICASE) && b >= 'a' && b <= 'z') {
+        oSet->byte_class[b - 'a' + 'A'] = oSet->byte_class[b];
+      }
+    }
+  }
+  oSet->nclasses = nclasses;
+
+  oSet->delta = malloc ((size_t)oSet->nstates * nclasses * sizeof(int));
+  oSet->match = malloc (oSet->nstates * sizeof(int));
+  oSet->shorter = malloc ((oSet->count + 1) * sizeof(int));
+  queue = malloc (oSet->nstates * sizeof(int));
+  fail = malloc (oSet->nstates * sizeof(int));
+  if (!oSet->delta || !oSet->match || !oSet->shorter || !queue || !fail) {
+    free (oSet->delta);
+    free (oSet->match);
+    free (oSet->shorter);
+    free (queue);
+    free (fail);
+    oSet->delta = oSet->match = oSet->shorter = NULL;
+    return 0;
+  }
+
+  /* the trie edges, -1 where there is none */
+  for (s = 0; s < oSet->nstates; s++) {
+    int *row = oSet->delta + (size_t)s * nclasses;
+    for (c = 0; c < nclasses; c++) {
+      row[c] = -1;
+    }
+    for (t = oSet->nodes[s].child; t >= 0; t = oSet->nodes[t].sibling) {
+      row[oSet->byte_class[oSet->nodes[t].byte]] = t;
+    }
+    oSet->match[s] = oSet->nodes[s].pattern;
+  }
+
+  /* breadth first, so the row of the failure state of s is complete
+     when s is reached. a missing edge of s goes where the same edge of
+     its failure state goes */
+  head = tail = 0;
+  queue[tail++] = 0;
+  fail[0] = 0;
+  while (head < tail) {
+    int *row, *frow;
+
+    s = queue[head++];
+    row = oSet->delta + (size_t)s * nclasses;
+    frow = oSet->delta + (size_t)fail[s] * nclasses;
+
+    for (c = 0; c < nclasses; c++) {
+      if (row[c] < 0) {
+        row[c] = s ? frow[c] : 0;
+        continue;
+      }
+      t = row[c];
+      fail[t] = s ? frow[c] : 0;
+      /* a state holds its own needle, else the longest one ending in
+         its failure state */
+      if (oSet->match[t] < 0) {
+        oSet->match[t] = oSet->match[fail[t]];
+      }
+      else {
+        oSet->shorter[oSet->match[t]] = oSet->match[fail[t]];
+      }
+      queue[tail++] = t;
+    }
+  }
+  free (queue);
+  free (fail);
+
+  /* the trie is no longer needed */
+  free (oSet->nodes);
+  oSet->nodes = NULL;
+  oSet->compiled = 1;
+  return 1;
+}
+
+/*returns the number of needles in oSet*/
+int StrSet_getCount(StrSet_T oSet)
+{
+  assert (oSet);
+  return oSet->count;
+}
+
+/*returns needle i of oSet*/
+const char *StrSet_getPattern(StrSet_T oSet, int i)
+{
+  assert (oSet);
+  assert (i >= 0 && i < oSet->count);
+  return oSet->ppcPatterns[i];
+}
+
+/*returns the length of needle i of oSet*/
+size_t StrSet_getLength(StrSet_T oSet, int i)
+{
+  assert (oSet);
+  assert (i >= 0 && i < oSet->count);
+  return oSet->lens[i];
+}
+
+/*searches the needles of the compiled oSet within the len bytes at h
+  from start on, in one pass. returns the leftmost match, the longest of
+  those starting there, and stores its needle in *piPattern unless
+  piPattern is NULL. with STR_WORD a match needs no word byte on either
+  side, the bytes before start included. returns NULL if no needle
+  occurs*/
+static char *StrSet_searchFrom(StrSet_T oSet, const unsigned char *h,
+                               size_t len, size_t start, int *piPattern)
+{
+  const unsigned char *cls;
+  const int *delta, *match;
+  size_t i, best = 0, stop = len;
+  int nclasses, s = 0, found = -1;
+  int word;
+
+  cls = oSet->byte_class;
+  delta = oSet->delta;
+  match = oSet->match;
+  nclasses = oSet->nclasses;
+  word = oSet->flags & STR_WORD;
+
+  for (i = start; i < stop; i++) {
+    int p;
+
+    s = delta[s * nclasses + cls[h[i]]];
+    if ((p = match[s]) < 0) {
+      continue;
+    }
+
+    /* the longest needle ending here starts the earliest. for a word
+       the shorter ones ending here are tried in turn */
+    if (word) {
+      if (i + 1 < len && IS_WORD (h[i + 1])) {
+        continue;
+      }
+      while (p >= 0 && !IsWordAt (h, len, i + 1 - oSet->lens[p],
+                                  oSet->lens[p])) {
+        p = oSet->shorter[p];
+      }
+      if (p < 0) {
+        continue;
+      }
+    }
+
+    /* a later match can only start earlier or at best while it is no
+       longer than the longest needle */
+    if (found < 0 || i + 1 - oSet->lens[p] <= best) {
+      best = i + 1 - oSet->lens[p];
+      found = p;
+      if (best + oSet->maxlen < stop) {
+        stop = best + oSet->maxlen;
+      }
+    }
+  }
+
+  if (found < 0) {
+    return NULL;
+  }
+  if (piPattern) {
+    *piPattern = found;
+  }
+  return (char *)(h + best);
+}
+
+/*searches the needles of the compiled oSet within the len bytes at
+  pcHaystack in one pass*/
+char *StrSet_search(StrSet_T oSet, const char *pcHaystack, size_t len,
+                    int *piPattern)
+{
+  assert (oSet);
+  assert (oSet->compiled);
+  assert (pcHaystack);
+
+  return StrSet_searchFrom (oSet, (const unsigned char *)pcHaystack, len, 0,
+                            piPattern);
+}
+
+/*the same from pcText + start on, as StrMatcher_searchAt()*/
+char *StrSet_searchAt(StrSet_T oSet, const char *pcText, size_t len,
+                      size_t start, int *piPattern)
+{
+  assert (oSet);
+  assert (oSet->compiled);
+  assert (pcText);
+  assert (start <= len);
+
+  return StrSet_searchFrom (oSet, (const unsigned char *)pcText, len, start,
+                            piPattern);
 }
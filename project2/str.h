@@ -9,4 +9,55 @@ int StrCompare(const char* pcS1, const char* pcS2);
 char *StrSearch(const char* pcHaystack, const char *pcNeedle);
 char *StrConcat(char *pcDest, const char* pcSrc);
 
+/* Part 2 */
+/* a search string compiled once and then searched for in many texts */
+typedef struct StrMatcher *StrMatcher_T;
+
+/* search flags: letters match in either case (ASCII only), and a match
+   needs a byte that is not a letter, digit or '_' on each side, or the
+   end of the text */
+#define STR_ICASE 0x1
+#define STR_WORD  0x2
+
+/* compile pcNeedle, returns NULL if insufficient memory is available */
+StrMatcher_T StrMatcher_new(const char *pcNeedle);
+/* the same, searched for as the flags given */
+StrMatcher_T StrMatcher_newFlags(const char *pcNeedle, int flags);
+void StrMatcher_free(StrMatcher_T oMatcher);
+size_t StrMatcher_getLength(StrMatcher_T oMatcher);
+/* first occurrence of the needle in the len bytes at pcHaystack, which
+   need not be null-terminated, or NULL */
+char *StrMatcher_search(StrMatcher_T oMatcher, const char *pcHaystack,
+                        size_t len);
+/* the same from pcText + start on, with the bytes before start still
+   seen by STR_WORD */
+char *StrMatcher_searchAt(StrMatcher_T oMatcher, const char *pcText,
+                          size_t len, size_t start);
+
+/* Part 3 */
+/* a set of search strings found together in one pass */
+typedef struct StrSet *StrSet_T;
+
+/* returns an empty set, or NULL if insufficient memory is available */
+StrSet_T StrSet_new(void);
+/* the same, searched for as the flags given */
+StrSet_T StrSet_newFlags(int flags);
+void StrSet_free(StrSet_T oSet);
+/* adds a search string of len > 0 bytes before StrSet_compile. returns
+   its index, or -1 if insufficient memory is available */
+int StrSet_add(StrSet_T oSet, const char *pcPattern, size_t len);
+/* builds the automaton, returns 0 if insufficient memory is available */
+int StrSet_compile(StrSet_T oSet);
+int StrSet_getCount(StrSet_T oSet);
+const char *StrSet_getPattern(StrSet_T oSet, int i);
+size_t StrSet_getLength(StrSet_T oSet, int i);
+/* leftmost-longest occurrence of any search string in the len bytes at
+   pcHaystack, or NULL. its index goes to *piPattern if not NULL */
+char *StrSet_search(StrSet_T oSet, const char *pcHaystack, size_t len,
+                    int *piPattern);
+/* the same from pcText + start on, with the bytes before start still
+   seen by STR_WORD */
+char *StrSet_searchAt(StrSet_T oSet, const char *pcText, size_t len,
+                      size_t start, int *piPattern);
+
 #endif /* _STR_H_ */
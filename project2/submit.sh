@@ -1,7 +1,7 @@
 #!/bin/sh
-./gcc209 -o sgrep sgrep.c str.c
+./gcc209 -D_DEFAULT_SOURCE -o sgrep sgrep.c str.c diff.c regexp.c zread.c -pthread -lz
 rm -rf 20180336_assign2
 rm -f 20180336_assign2.tar.gz
 mkdir -p 20180336_assign2
-cp sgrep.c str.c str.h readme EthicsOath.pdf 20180336_assign2
+cp sgrep.c str.c str.h diff.c diff.h regexp.c regexp.h zread.c zread.h readme EthicsOath.pdf 20180336_assign2
 tar zcf 20180336_assign2.tar.gz 20180336_assign2
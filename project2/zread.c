@@ -0,0 +1,386 @@
+/* 20180336 송우선
+Assignment.2
+*/
+
+#include <assert.h> /* to use assert() */
+#include <errno.h>
+#include <stdlib.h> /* for malloc() */
+#include <string.h>
+#include <pthread.h>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#include "zread.h"
+
+/* size of each of the two output buffers, and of the input buffer */
+#define ZBUF_SIZE (256 * 1024)
+#define ZIN_SIZE (64 * 1024)
+
+#define FALSE 0
+#define TRUE  1
+
+/* one half of the double buffer. it is either being filled by the
+   thread, or full and being read */
+struct ZBuffer {
+  char *data;
+  size_t len;
+  int full;
+};
+
+struct ZReader {
+  int fd;
+  int format;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;     /* signaled when a buffer is filled or emptied */
+  struct ZBuffer bufs[2];
+  int drain;               /* the buffer the reader takes bytes from */
+  size_t pos;              /* and the bytes of it already taken */
+  int done;                /* the thread has put its last buffer */
+  int stop;                /* the reader asks the thread to stop */
+  const char *pcError;     /* why the thread stopped early, or NULL */
+  char *head;              /* bytes read from fd before the thread began */
+  size_t head_len;
+  char in[ZIN_SIZE];
+};
+
+/*returns the format of the input starting with the len bytes at p*/
+int ZReader_detect(const char *p, size_t len)
+{
+  const unsigned char *s = (const unsigned char *)p;
+
+  assert (p || len == 0);
+
+  if (len >= 2 && s[0] == 0x1f && s[1] == 0x8b)
+    return ZREAD_GZIP;
+  if (len >= 4 && s[0] == 0x28 && s[1] == 0xb5 && s[2] == 0x2f &&
+      s[3] == 0xfd)
+    return ZREAD_ZSTD;
+  return ZREAD_NONE;
+}
+
+/* The decompressing thread */
+/*------------------------------------------------------------------------*/
+/*reads the next compressed bytes into oReader->in, after the head.
+  returns their number, 0 at the end of fd, or -1 on a read error*/
+static ssize_t ReadInput(ZReader_T oReader, const char **ppcIn)
+{
+  ssize_t n;
+
+  if (oReader->head_len > 0) {
+    *ppcIn = oReader->head;
+    n = oReader->head_len;
+    oReader->head_len = 0;
+    return n;
+  }
+  *ppcIn = oReader->in;
+  while ((n = read (oReader->fd, oReader->in, ZIN_SIZE)) < 0) {
+    if (errno != EINTR)
+      break;
+  }
+  return n;
+}
+
+/*waits for buffer i to be emptied by the reader, and returns its data,
+  or NULL if the reader asks the thread to stop*/
+static char *WaitEmpty(ZReader_T oReader, int i)
+{
+  int stop;
+
+  pthread_mutex_lock (&oReader->lock);
+  while (oReader->bufs[i].full && !oReader->stop)
+    pthread_cond_wait (&oReader->cond, &oReader->lock);
+  stop = oReader->stop;
+  pthread_mutex_unlock (&oReader->lock);
+  return stop ? NULL : oReader->bufs[i].data;
+}
+
+/*hands buffer i, holding len bytes, to the reader*/
+static void PutFull(ZReader_T oReader, int i, size_t len)
+{
+  pthread_mutex_lock (&oReader->lock);
+  oReader->bufs[i].len = len;
+  oReader->bufs[i].full = TRUE;
+  pthread_cond_broadcast (&oReader->cond);
+  pthread_mutex_unlock (&oReader->lock);
+}
+
+/*tells the reader no buffer follows, and why if pcError is not NULL*/
+static void PutDone(ZReader_T oReader, const char *pcError)
+{
+  pthread_mutex_lock (&oReader->lock);
+  oReader->done = TRUE;
+  oReader->pcError = pcError;
+  pthread_cond_broadcast (&oReader->cond);
+  pthread_mutex_unlock (&oReader->lock);
+}
+
+/*inflates gzip members one after another, as zcat does*/
+static const char *InflateGzip(ZReader_T oReader)
+{
+  z_stream zs;
+  const char *pcIn, *pcError = NULL;
+  char *out;
+  ssize_t n;
+  int i = 0, ret;
+  int in_member = TRUE;     /* a member was begun and not ended */
+
+  memset (&zs, 0, sizeof(zs));
+  /* 15 bits of window, +16 for a gzip header */
+  if (inflateInit2 (&zs, 15 + 16) != Z_OK)
+    return "out of memory";
+
+  if (!(out = WaitEmpty (oReader, i)))
+    goto done;
+  zs.next_out = (Bytef *)out;
+  zs.avail_out = ZBUF_SIZE;
+
+  for (;;) {
+    if (zs.avail_in == 0) {
+      if ((n = ReadInput (oReader, &pcIn)) < 0) {
+        pcError = "failed to read the compressed input";
+        break;
+      }
+      if (n == 0) {
+        if (in_member)
+          pcError = "unexpected end of compressed input";
+        break;
+      }
+      zs.next_in = (Bytef *)pcIn;
+      zs.avail_in = n;
+    }
+
+    ret = inflate (&zs, Z_NO_FLUSH);
+    if (ret == Z_STREAM_END) {
+      /* another member may follow */
+      inflateReset (&zs);
+      in_member = FALSE;
+    }
+    else if (ret == Z_OK)
+      in_member = TRUE;
+    else if (ret == Z_MEM_ERROR) {
+      pcError = "out of memory";
+      break;
+    }
+    else if (ret != Z_BUF_ERROR) {
+      pcError = "corrupt compressed input";
+      break;
+    }
+
+    if (zs.avail_out == 0) {
+      PutFull (oReader, i, ZBUF_SIZE);
+      i ^= 1;
+      if (!(out = WaitEmpty (oReader, i)))
+        goto done;
+      zs.next_out = (Bytef *)out;
+      zs.avail_out = ZBUF_SIZE;
+    }
+  }
+  /* what was decompressed before an error is still read */
+  if (zs.avail_out < ZBUF_SIZE)
+    PutFull (oReader, i, ZBUF_SIZE - zs.avail_out);
+
+ done:
+  inflateEnd (&zs);
+  return pcError;
+}
+
+#ifdef HAVE_ZSTD
+/*decompresses zstd frames one after another, as zstdcat does*/
+static const char *DecompressZstd(ZReader_T oReader)
+{
+  ZSTD_DStream *ds;
+  ZSTD_inBuffer in;
+  ZSTD_outBuffer out;
+  const char *pcIn, *pcError = NULL;
+  ssize_t n;
+  size_t ret;
+  int i = 0;
+  int in_frame = TRUE;      /* a frame was begun and not ended */
+
+  if (!(ds = ZSTD_createDStream ()))
+    return "out of memory";
+  ZSTD_initDStream (ds);
+
+  in.src = NULL;
+  in.size = in.pos = 0;
+  out.size = ZBUF_SIZE;
+  out.pos = 0;
+  if (!(out.dst = WaitEmpty (oReader, i)))
+    goto done;
+
+  for (;;) {
+    if (in.pos == in.size) {
+      if ((n = ReadInput (oReader, &pcIn)) < 0) {
+        pcError = "failed to read the compressed input";
+        break;
+      }
+      if (n == 0) {
+        if (in_frame)
+          pcError = "unexpected end of compressed input";
+        break;
+      }
+      in.src = pcIn;
+      in.size = n;
+      in.pos = 0;
+    }
+
+    ret = ZSTD_decompressStream (ds, &out, &in);
+    if (ZSTD_isError (ret)) {
+      pcError = "corrupt compressed input";
+      break;
+    }
+    /* 0 when a frame is complete and flushed */
+    in_frame = ret != 0;
+
+    if (out.pos == out.size) {
+      PutFull (oReader, i, ZBUF_SIZE);
+      i ^= 1;
+      if (!(out.dst = WaitEmpty (oReader, i)))
+        goto done;
+      out.pos = 0;
+    }
+  }
+  if (out.pos > 0)
+    PutFull (oReader, i, out.pos);
+
+ done:
+  ZSTD_freeDStream (ds);
+  return pcError;
+}
+#endif /* HAVE_ZSTD */
+
+static void *ZReaderThread(void *arg)
+{
+  ZReader_T oReader = arg;
+  const char *pcError;
+
+#ifdef HAVE_ZSTD
+  if (oReader->format == ZREAD_ZSTD)
+    pcError = DecompressZstd (oReader);
+  else
+#endif
+    pcError = InflateGzip (oReader);
+  PutDone (oReader, pcError);
+  return NULL;
+}
+
+/* The reader */
+/*------------------------------------------------------------------------*/
+ZReader_T ZReader_new(int fd, int format, const char *pcHead, size_t len,
+                      const char **ppcError)
+{
+  ZReader_T oReader;
+
+  assert (pcHead || len == 0);
+  assert (ppcError);
+
+#ifndef HAVE_ZSTD
+  if (format == ZREAD_ZSTD) {
+    *ppcError = "zstd input is not supported by this build";
+    return NULL;
+  }
+#endif
+  if (format != ZREAD_GZIP && format != ZREAD_ZSTD) {
+    *ppcError = "unknown compressed format";
+    return NULL;
+  }
+
+  *ppcError = "out of memory";
+  if (!(oReader = calloc (1, sizeof(*oReader))))
+    return NULL;
+  oReader->fd = fd;
+  oReader->format = format;
+  oReader->bufs[0].data = malloc (ZBUF_SIZE);
+  oReader->bufs[1].data = malloc (ZBUF_SIZE);
+  oReader->head = len ? malloc (len) : NULL;
+  if (!oReader->bufs[0].data || !oReader->bufs[1].data ||
+      (len && !oReader->head)) {
+    free (oReader->bufs[0].data);
+    free (oReader->bufs[1].data);
+    free (oReader->head);
+    free (oReader);
+    return NULL;
+  }
+  memcpy (oReader->head, pcHead, len);
+  oReader->head_len = len;
+
+  pthread_mutex_init (&oReader->lock, NULL);
+  pthread_cond_init (&oReader->cond, NULL);
+  if (pthread_create (&oReader->thread, NULL, ZReaderThread, oReader)) {
+    *ppcError = "failed to start a thread";
+    pthread_cond_destroy (&oReader->cond);
+    pthread_mutex_destroy (&oReader->lock);
+    free (oReader->bufs[0].data);
+    free (oReader->bufs[1].data);
+    free (oReader->head);
+    free (oReader);
+    return NULL;
+  }
+  *ppcError = NULL;
+  return oReader;
+}
+
+void ZReader_free(ZReader_T oReader)
+{
+  if (!oReader)
+    return;
+
+  pthread_mutex_lock (&oReader->lock);
+  oReader->stop = TRUE;
+  pthread_cond_broadcast (&oReader->cond);
+  pthread_mutex_unlock (&oReader->lock);
+  pthread_join (oReader->thread, NULL);
+
+  pthread_cond_destroy (&oReader->cond);
+  pthread_mutex_destroy (&oReader->lock);
+  free (oReader->bufs[0].data);
+  free (oReader->bufs[1].data);
+  free (oReader->head);
+  free (oReader);
+}
+
+/*copies from the full buffer being read, and gives it back to the
+  thread once it is all taken*/
+ssize_t ZReader_read(ZReader_T oReader, char *buf, size_t len)
+{
+  struct ZBuffer *b = &oReader->bufs[oReader->drain];
+  size_t n;
+
+  assert (oReader);
+  assert (buf);
+
+  pthread_mutex_lock (&oReader->lock);
+  while (!b->full && !oReader->done)
+    pthread_cond_wait (&oReader->cond, &oReader->lock);
+  if (!b->full) {
+    /* every buffer put was read */
+    int error = oReader->pcError != NULL;
+    pthread_mutex_unlock (&oReader->lock);
+    return error ? -1 : 0;
+  }
+  pthread_mutex_unlock (&oReader->lock);
+
+  n = b->len - oReader->pos;
+  if (n > len)
+    n = len;
+  memcpy (buf, b->data + oReader->pos, n);
+  oReader->pos += n;
+
+  if (oReader->pos == b->len) {
+    pthread_mutex_lock (&oReader->lock);
+    b->full = FALSE;
+    pthread_cond_broadcast (&oReader->cond);
+    pthread_mutex_unlock (&oReader->lock);
+    oReader->drain ^= 1;
+    oReader->pos = 0;
+  }
+  return n;
+}
+
+const char *ZReader_getError(ZReader_T oReader)
+{
+  assert (oReader);
+  return oReader->pcError;
+}
@@ -0,0 +1,36 @@
+#ifndef _ZREAD_H_
+#define _ZREAD_H_
+#include <unistd.h> /* for typedef of size_t, ssize_t */
+
+/* a reader of compressed input. a thread of its own decompresses the
+   input into two buffers in turn, so that one is filled while the other
+   is read.
+
+   gzip input is read with zlib, so link with -lz. zstd input is read
+   only when built with -DHAVE_ZSTD and linked with -lzstd */
+typedef struct ZReader *ZReader_T;
+
+/* bytes of input ZReader_detect() needs to tell a format */
+#define ZREAD_HEAD 4
+
+enum { ZREAD_NONE, ZREAD_GZIP, ZREAD_ZSTD };
+
+/* returns the format of the input starting with the len bytes at p, or
+   ZREAD_NONE if it is not compressed. len should be ZREAD_HEAD, or all
+   of a shorter input */
+int ZReader_detect(const char *p, size_t len);
+
+/* starts decompressing the input of format, made of the len bytes at
+   pcHead that were already read from fd and the rest of fd. returns
+   NULL and points *ppcError to what was wrong if it cannot start */
+ZReader_T ZReader_new(int fd, int format, const char *pcHead, size_t len,
+                      const char **ppcError);
+/* stops the thread and frees oReader. fd is not closed */
+void ZReader_free(ZReader_T oReader);
+/* copies up to len decompressed bytes to buf as read() does. returns
+   their number, 0 at the end of the input, and -1 on an error, which
+   ZReader_getError() describes */
+ssize_t ZReader_read(ZReader_T oReader, char *buf, size_t len);
+const char *ZReader_getError(ZReader_T oReader);
+
+#endif /* _ZREAD_H_ */
@@ -0,0 +1,399 @@
+/* 20180336 Woosun Song */
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "customer_manager.h"
+
+/* customer_manager2.c with open addressing. each table is one flat array
+   of slots holding the hash and length of a key and a pointer to its
+   user. a lookup probes consecutive slots, kept in Robin Hood order, and
+   reads a user only when both the hash and the length match */
+
+#define INITIAL_SLOT_CNT 0x400   /* a power of two */
+#define MAX_SLOT_CNT 0x40000000  /* so a slot index fits in an int */
+
+/* the tables double once more than MAX_LOAD_NUM / MAX_LOAD_DEN full */
+#define MAX_LOAD_NUM 4
+#define MAX_LOAD_DEN 5
+
+struct UserInfo {
+  unsigned int purchase;     // purchase amount (> 0)
+  unsigned int id_hash;
+  unsigned int name_hash;
+  char *name;                // customer name, right after the id
+  char id[];                 // customer id
+};
+
+struct Slot {
+  unsigned int hash;         // hash of the key, 0 for an empty slot
+  unsigned int len;          // length of the key
+  struct UserInfo *user;
+};
+
+struct DB {
+  struct Slot *table_id;     // pointer to the array
+  struct Slot *table_name;
+  unsigned int numItems;
+  unsigned int slotCount;    // a power of two
+};
+
+/* Return a hash code for pcKey, never 0, and store its length in
+   *puiLen. FNV-1a, with the high bits mixed into the low bits that a
+   slot index keeps. */
+static unsigned int hash_function(const char *pcKey, unsigned int *puiLen)
+{
+   unsigned int i;
+   unsigned int uiHash = 2166136261U;
+   for (i = 0; pcKey[i] != '\0'; i++) {
+      uiHash ^= (unsigned char)pcKey[i];
+      uiHash *= 16777619U;
+   }
+   *puiLen = i;
+   uiHash ^= uiHash >> 16;
+   uiHash *= 0x85ebca6bU;
+   uiHash ^= uiHash >> 13;
+   return uiHash ? uiHash : 1;
+}
+
+/* how far slot i of a table of mask + 1 slots is from where its key
+   hashes to */
+static unsigned int probe_distance (unsigned int hash, unsigned int i,
+                                    unsigned int mask) {
+  return (i - (hash & mask)) & mask;
+}
+
+/* find the slot of key in table, by id or by name. in Robin Hood order
+   the search stops at the first slot that is closer to its own home
+   than key would be. returns -1 if key is not there */
+static int find_slot (const struct Slot *table, unsigned int mask,
+                      const char *key, int by_name) {
+
+  unsigned int len, dist;
+  unsigned int hash = hash_function (key, &len);
+  unsigned int i = hash & mask;
+
+  for (dist = 0; ; dist++, i = (i + 1) & mask) {
+    const struct Slot *s = &table[i];
+
+    if (s->hash == 0 || probe_distance (s->hash, i, mask) < dist) {
+      return -1;
+    }
+    if (s->hash == hash && s->len == len &&
+        !memcmp (by_name ? s->user->name : s->user->id, key, len)) {
+      return i;
+    }
+  }
+}
+
+/* find the slot of user in table, by the hash it was put in with */
+static unsigned int find_user_slot (const struct Slot *table,
+                                    unsigned int mask, unsigned int hash,
+                                    const struct UserInfo *user) {
+
+  unsigned int i = hash & mask;
+
+  while (table[i].user != user) {
+    i = (i + 1) & mask;
+  }
+  return i;
+}
+
+/* put s in table. a slot further from its home than the one in its way
+   takes that place, and the one displaced goes on */
+static void insert_slot (struct Slot *table, unsigned int mask,
+                         struct Slot s) {
+
+  unsigned int i = s.hash & mask;
+  unsigned int dist = 0, d;
+  struct Slot tmp;
+
+  for (;; i = (i + 1) & mask, dist++) {
+    if (table[i].hash == 0) {
+      table[i] = s;
+      return;
+    }
+    d = probe_distance (table[i].hash, i, mask);
+    if (d < dist) {
+      tmp = table[i];
+      table[i] = s;
+      s = tmp;
+      dist = d;
+    }
+  }
+}
+
+/* empty slot i, shifting back the slots after it that are not at their
+   home, so no tombstone is left */
+static void remove_slot (struct Slot *table, unsigned int mask,
+                         unsigned int i) {
+
+  unsigned int next = (i + 1) & mask;
+
+  while (table[next].hash != 0 &&
+         probe_distance (table[next].hash, next, mask) != 0) {
+    table[i] = table[next];
+    i = next;
+    next = (next + 1) & mask;
+  }
+  memset (&table[i], 0, sizeof (table[i]));
+}
+
+/* double the slot count of both tables. the slots keep their hashes, so
+   no key is hashed again */
+static int grow (DB_T d) {
+
+  unsigned int i, count = d->slotCount * 2;
+  struct Slot *table_id, *table_name;
+
+  if (d->slotCount >= MAX_SLOT_CNT) {
+    return 0;
+  }
+
+  table_id = calloc (count, sizeof (struct Slot));
+  table_name = calloc (count, sizeof (struct Slot));
+  if (!table_id || !table_name) {
+    free (table_id);
+    free (table_name);
+    return 0;
+  }
+
+  for (i = 0; i < d->slotCount; i++) {
+    if (d->table_id[i].hash) {
+      insert_slot (table_id, count - 1, d->table_id[i]);
+    }
+    if (d->table_name[i].hash) {
+      insert_slot (table_name, count - 1, d->table_name[i]);
+    }
+  }
+
+  free (d->table_id);
+  free (d->table_name);
+  d->table_id = table_id;
+  d->table_name = table_name;
+  d->slotCount = count;
+  return 1;
+}
+
+/* take user out of both tables and free it */
+static void remove_user (DB_T d, unsigned int id_slot,
+                         unsigned int name_slot) {
+
+  unsigned int mask = d->slotCount - 1;
+  struct UserInfo *user = d->table_id[id_slot].user;
+
+  remove_slot (d->table_id, mask, id_slot);
+  remove_slot (d->table_name, mask, name_slot);
+  free (user);
+  d->numItems--;
+}
+
+/*--------------------------------------------------------------------*/
+DB_T
+CreateCustomerDB(void)
+{
+  DB_T d;
+
+  d = (DB_T) calloc(1, sizeof(struct DB));
+  if (d == NULL) {
+    fprintf(stderr, "Can't allocate a memory for DB_T\n");
+    return NULL;
+  }
+
+  d->slotCount = INITIAL_SLOT_CNT;
+  d->table_id = calloc (d->slotCount, sizeof (struct Slot));
+  d->table_name = calloc (d->slotCount, sizeof (struct Slot));
+
+  if (!d->table_id || !d->table_name) {
+    fprintf(stderr, "Can't allocate a memory for hash table of slot size %u\n", d->slotCount);
+    free (d->table_id);
+    free (d->table_name);
+    free (d);
+    return NULL;
+  }
+
+  return d;
+}
+/*--------------------------------------------------------------------*/
+void
+DestroyCustomerDB(DB_T d)
+{
+  unsigned int i;
+
+  /* do nothing if d == NULL */
+  if (!d) {
+    return;
+  }
+
+  for (i = 0; i < d->slotCount; i++) {
+    free (d->table_id[i].user);
+  }
+  free (d->table_id);
+  free (d->table_name);
+  free (d);
+}
+/*--------------------------------------------------------------------*/
+int
+RegisterCustomer(DB_T d, const char *id,
+     const char *name, const int purchase)
+{
+  struct UserInfo *new_user;
+  struct Slot s;
+  unsigned int id_len, name_len;
+
+  /* return error if d == NULL */
+  if (!d || !id || !name || purchase <= 0) {
+    fprintf(stderr, "RegisterCustomer: invalid argument\n");
+    return -1;
+  }
+
+  /* check if user already exists */
+  if (find_slot (d->table_id, d->slotCount - 1, id, 0) >= 0 ||
+      find_slot (d->table_name, d->slotCount - 1, name, 1) >= 0) {
+    fprintf(stderr, "Attempt to add a user that already exists\n");
+    return -1;
+  }
+
+  /* table expansion */
+  if ((d->numItems + 1) * (unsigned long)MAX_LOAD_DEN >
+      d->slotCount * (unsigned long)MAX_LOAD_NUM) {
+    if (!grow (d)) {
+      fprintf(stderr, "RegisterCustomer: rehash fail\n");
+      return -1;
+    }
+  }
+
+  /* one block holds the user, its id and its name */
+  s.hash = hash_function (id, &id_len);
+  new_user = malloc (sizeof (struct UserInfo) + id_len + 1 +
+                     strlen (name) + 1);
+  if (!new_user) {
+    fprintf(stderr, "Can't allocate a memory for new user\n");
+    return -1;
+  }
+  new_user->purchase = purchase;
+  new_user->id_hash = s.hash;
+  new_user->name_hash = hash_function (name, &name_len);
+  new_user->name = new_user->id + id_len + 1;
+  memcpy (new_user->id, id, id_len + 1);
+  memcpy (new_user->name, name, name_len + 1);
+
+  s.len = id_len;
+  s.user = new_user;
+  insert_slot (d->table_id, d->slotCount - 1, s);
+
+  s.hash = new_user->name_hash;
+  s.len = name_len;
+  insert_slot (d->table_name, d->slotCount - 1, s);
+
+  d->numItems++;
+  return 0;
+}
+/*--------------------------------------------------------------------*/
+int
+UnregisterCustomerByID(DB_T d, const char *id)
+{
+  struct UserInfo *victim;
+  int i;
+
+  /* return error if d == NULL */
+  if (!d || !id) {
+    fprintf(stderr, "UnregisterCustomerByID: null argument\n");
+    return -1;
+  }
+
+  if ((i = find_slot (d->table_id, d->slotCount - 1, id, 0)) < 0) {
+    fprintf(stderr,"Customer with ID %s was not found\n",id);
+    return -1;
+  }
+
+  victim = d->table_id[i].user;
+  remove_user (d, i, find_user_slot (d->table_name, d->slotCount - 1,
+                                     victim->name_hash, victim));
+  return 0;
+}
+
+/*--------------------------------------------------------------------*/
+int
+UnregisterCustomerByName(DB_T d, const char *name)
+{
+  struct UserInfo *victim;
+  int i;
+
+  /* return error if d == NULL */
+  if (!d || !name) {
+    fprintf(stderr, "UnregisterCustomerByName: null argument\n");
+    return -1;
+  }
+
+  if ((i = find_slot (d->table_name, d->slotCount - 1, name, 1)) < 0) {
+    fprintf(stderr,"Customer with name %s was not found\n",name);
+    return -1;
+  }
+
+  victim = d->table_name[i].user;
+  remove_user (d, find_user_slot (d->table_id, d->slotCount - 1,
+                                  victim->id_hash, victim), i);
+  return 0;
+}
+/*--------------------------------------------------------------------*/
+int
+GetPurchaseByID(DB_T d, const char* id)
+{
+  int i;
+
+  /* return error if d == NULL */
+  if (!d || !id) {
+    fprintf(stderr, "GetPurchaseByID: null argument\n");
+    return -1;
+  }
+
+  if ((i = find_slot (d->table_id, d->slotCount - 1, id, 0)) < 0) {
+    fprintf(stderr,"Customer with ID %s was not found\n",id);
+    return -1;
+  }
+
+  return d->table_id[i].user->purchase;
+}
+/*--------------------------------------------------------------------*/
+int
+GetPurchaseByName(DB_T d, const char* name)
+{
+  int i;
+
+  /* return error if d == NULL */
+  if (!d || !name) {
+    fprintf(stderr, "GetPurchaseByName: null argument\n");
+    return -1;
+  }
+
+  if ((i = find_slot (d->table_name, d->slotCount - 1, name, 1)) < 0) {
+    fprintf(stderr,"Customer with name %s was not found\n",name);
+    return -1;
+  }
+
+  return d->table_name[i].user->purchase;
+}
+/*--------------------------------------------------------------------*/
+int
+GetSumCustomerPurchase(DB_T d, FUNCPTR_T fp)
+{
+  unsigned int i;
+  int sum = 0;
+  struct UserInfo *u;
+
+  /* return error if d == NULL */
+  if (!d || !fp) {
+    fprintf(stderr, "GetSumCustomerPurchase: null argument\n");
+    return -1;
+  }
+
+  /* one pass over the slots */
+  for (i = 0; i < d->slotCount; i++) {
+    if ((u = d->table_id[i].user)) {
+      sum += fp (u->id, u->name, u->purchase);
+    }
+  }
+
+  return sum;
+}
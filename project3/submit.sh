@@ -3,3 +3,5 @@
 ./testclient1 -c
 ./gcc209 -D_GNU_SOURCE -o testclient2 testclient.c customer_manager2.c
 ./testclient2 -c
+./gcc209 -D_GNU_SOURCE -o testclient3 testclient.c customer_manager3.c
+./testclient3 -c